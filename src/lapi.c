@@ -20,6 +20,7 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -385,6 +386,13 @@ LUA_API const char *lua_tolstring (lua_State *L, int idx, size_t *len) {
   }
   if (len != NULL)
     *len = vslen(o);
+  if (isbuffstr(tsvalue(o))) {
+    const char *s;
+    lua_lock(L);  /* 'luaS_terminate' may create a new buffer */
+    s = luaS_terminate(L, tsvalue(o));
+    lua_unlock(L);
+    return s;
+  }
   return svalue(o);
 }
 
@@ -505,6 +513,26 @@ LUA_API const char *lua_pushstring (lua_State *L, const char *s) {
 }
 
 
+/*
+** Pushes the 'len' bytes of the string at 'idx' from its byte 'i'
+** (counting from 0). Large substrings may share bytes with the string.
+*/
+LUA_API void lua_pushsubstring (lua_State *L, int idx, size_t i,
+                                size_t len) {
+  StkId o;
+  TString *ts;
+  lua_lock(L);
+  o = index2addr(L, idx);
+  api_check(L, ttisstring(o), "string expected");
+  api_check(L, i <= vslen(o) && len <= vslen(o) - i, "invalid substring");
+  ts = luaS_sub(L, tsvalue(o), i, len);
+  setsvalue2s(L, L->top, ts);
+  api_incr_top(L);
+  luaC_checkGC(L);
+  lua_unlock(L);
+}
+
+
 LUA_API const char *lua_pushvfstring (lua_State *L, const char *fmt,
                                       va_list argp) {
   const char *ret;
@@ -629,7 +657,10 @@ LUA_API int lua_geti (lua_State *L, int idx, lua_Integer n) {
   const TValue *slot;
   lua_lock(L);
   t = index2addr(L, idx);
-  if (luaV_fastget(L, t, n, slot, luaH_getint)) {
+  if (luaV_getpacked(t, n, L->top)) {
+    api_incr_top(L);
+  }
+  else if (luaV_fastget(L, t, n, slot, luaH_getint)) {
     setobj2s(L, L->top, slot);
     api_incr_top(L);
   }
@@ -785,7 +816,8 @@ LUA_API void lua_seti (lua_State *L, int idx, lua_Integer n) {
   lua_lock(L);
   api_checknelems(L, 1);
   t = index2addr(L, idx);
-  if (luaV_fastset(L, t, n, slot, luaH_getint, L->top - 1))
+  if (luaV_setpacked(t, n, L->top - 1) ||
+      luaV_fastset(L, t, n, slot, luaH_getint, L->top - 1))
     L->top--;  /* pop value */
   else {
     setivalue(L->top, n);
@@ -799,13 +831,13 @@ LUA_API void lua_seti (lua_State *L, int idx, lua_Integer n) {
 
 LUA_API void lua_rawset (lua_State *L, int idx) {
   StkId o;
-  TValue *slot;
+  Table *t;
   lua_lock(L);
   api_checknelems(L, 2);
   o = index2addr(L, idx);
   api_check(L, ttistable(o), "table expected");
-  slot = luaH_set(L, hvalue(o), L->top - 2);
-  setobj2t(L, slot, L->top - 1);
+  t = hvalue(o);
+  luaH_finishset(L, t, L->top - 2, luaH_get(t, L->top - 2), L->top - 1);
   invalidateTMcache(hvalue(o));
   luaC_barrierback(L, hvalue(o), L->top-1);
   L->top -= 2;
@@ -1012,14 +1044,14 @@ LUA_API int lua_load (lua_State *L, lua_Reader reader, void *data,
 }
 
 
-LUA_API int lua_dump (lua_State *L, lua_Writer writer, void *data, int strip) {
+LUA_API int lua_dump (lua_State *L, lua_Writer writer, void *data, int flags) {
   int status;
   TValue *o;
   lua_lock(L);
   api_checknelems(L, 1);
   o = L->top - 1;
   if (isLfunction(o))
-    status = luaU_dump(L, getproto(o), writer, data, strip);
+    status = luaU_dump(L, getproto(o), writer, data, flags);
   else
     status = 1;
   lua_unlock(L);
@@ -1097,6 +1129,18 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       res = g->gcrunning;
       break;
     }
+    case LUA_GCSETSTRGROW: {
+      res = g->strt.grow;
+      if (data < 10) data = 10;  /* avoid ridiculous low values (and 0) */
+      g->strt.grow = data;
+      break;
+    }
+    case LUA_GCSETSTRSHRINK: {
+      res = g->strt.shrink;
+      if (data < 0) data = 0;  /* 0 never shrinks the table */
+      g->strt.shrink = data;
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
@@ -1104,6 +1148,46 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
 }
 
 
+/*
+** Turns the JIT compiler on or off, returning whether it was on. (It
+** stays off where it is not supported.)
+*/
+LUA_API int lua_jit (lua_State *L, int mode) {
+  global_State *g = G(L);
+  int res;
+  lua_lock(L);
+  res = g->jiton;
+  g->jiton = (mode == LUA_JITON && LUA_USE_JIT);
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Fills 'st' with the statistics of the string table. (The longest
+** chain is found by traversing the whole table.)
+*/
+LUA_API void lua_strstats (lua_State *L, lua_StrStats *st) {
+  stringtable *tb;
+  int i;
+  lua_lock(L);
+  tb = &G(L)->strt;
+  st->size = tb->size;
+  st->nuse = tb->nuse;
+  st->maxchain = 0;
+  for (i = 0; i < tb->size; i++) {
+    int n = 0;
+    TString *ts;
+    for (ts = tb->hash[i]; ts != NULL; ts = ts->u.hnext)
+      n++;
+    if (n > st->maxchain) st->maxchain = n;
+  }
+  st->hits = cast(size_t, tb->hits);
+  st->misses = cast(size_t, tb->misses);
+  lua_unlock(L);
+}
+
+
 
 /*
 ** miscellaneous functions
@@ -1136,6 +1220,16 @@ LUA_API int lua_next (lua_State *L, int idx) {
 }
 
 
+LUA_API void lua_cleartable (lua_State *L, int idx) {
+  StkId t;
+  lua_lock(L);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  luaH_clear(L, hvalue(t));
+  lua_unlock(L);
+}
+
+
 LUA_API void lua_concat (lua_State *L, int n) {
   lua_lock(L);
   api_checknelems(L, n);
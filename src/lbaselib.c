@@ -170,16 +170,42 @@ static int luaB_rawset (lua_State *L) {
 }
 
 
+/* option of 'collectgarbage' that is not an option of 'lua_gc' */
+#define GCSTRSTATS	(-1)
+
+
+static int strstats (lua_State *L) {
+  lua_StrStats st;
+  lua_strstats(L, &st);
+  lua_createtable(L, 0, 5);
+  lua_pushinteger(L, st.size);
+  lua_setfield(L, -2, "size");
+  lua_pushinteger(L, st.nuse);
+  lua_setfield(L, -2, "nuse");
+  lua_pushinteger(L, st.maxchain);
+  lua_setfield(L, -2, "maxchain");
+  lua_pushinteger(L, (lua_Integer)st.hits);
+  lua_setfield(L, -2, "hits");
+  lua_pushinteger(L, (lua_Integer)st.misses);
+  lua_setfield(L, -2, "misses");
+  return 1;
+}
+
+
 static int luaB_collectgarbage (lua_State *L) {
   static const char *const opts[] = {"stop", "restart", "collect",
     "count", "step", "setpause", "setstepmul",
-    "isrunning", NULL};
+    "isrunning", "setstrgrow", "setstrshrink", "strstats", NULL};
   static const int optsnum[] = {LUA_GCSTOP, LUA_GCRESTART, LUA_GCCOLLECT,
     LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL,
-    LUA_GCISRUNNING};
+    LUA_GCISRUNNING, LUA_GCSETSTRGROW, LUA_GCSETSTRSHRINK, GCSTRSTATS};
   int o = optsnum[luaL_checkoption(L, 1, "collect", opts)];
-  int ex = (int)luaL_optinteger(L, 2, 0);
-  int res = lua_gc(L, o, ex);
+  int ex;
+  int res;
+  if (o == GCSTRSTATS)
+    return strstats(L);
+  ex = (int)luaL_optinteger(L, 2, 0);
+  res = lua_gc(L, o, ex);
   switch (o) {
     case LUA_GCCOUNT: {
       int b = lua_gc(L, LUA_GCCOUNTB, 0);
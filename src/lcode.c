@@ -12,6 +12,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "lua.h"
 
@@ -36,6 +37,10 @@
 #define hasjumps(e)	((e)->t != (e)->f)
 
 
+/* source line of instruction 'pc' of the function being generated */
+#define getline(fs,pc)	((fs)->ls->dyd->lines.arr[(fs)->firstline + (pc)])
+
+
 /*
 ** If expression is a numeric constant, fills 'v' with its value
 ** and returns 1. Otherwise, returns 0.
@@ -292,15 +297,17 @@ void luaK_patchclose (FuncState *fs, int list, int level) {
 */
 static int luaK_code (FuncState *fs, Instruction i) {
   Proto *f = fs->f;
+  Dyndata *dyd = fs->ls->dyd;
   dischargejpc(fs);  /* 'pc' will change */
   /* put new instruction in code array */
   luaM_growvector(fs->ls->L, f->code, fs->pc, f->sizecode, Instruction,
                   MAX_INT, "opcodes");
   f->code[fs->pc] = i;
   /* save corresponding line information */
-  luaM_growvector(fs->ls->L, f->lineinfo, fs->pc, f->sizelineinfo, int,
-                  MAX_INT, "opcodes");
-  f->lineinfo[fs->pc] = fs->ls->lastline;
+  lua_assert(dyd->lines.n == fs->firstline + fs->pc);
+  luaM_growvector(fs->ls->L, dyd->lines.arr, dyd->lines.n, dyd->lines.size,
+                  int, MAX_INT, "opcodes");
+  dyd->lines.arr[dyd->lines.n++] = fs->ls->lastline;
   return fs->pc++;
 }
 
@@ -841,6 +848,7 @@ static int jumponcond (FuncState *fs, expdesc *e, int cond) {
     Instruction ie = getinstruction(fs, e);
     if (GET_OPCODE(ie) == OP_NOT) {
       fs->pc--;  /* remove previous OP_NOT */
+      fs->ls->dyd->lines.n--;  /* and its line information */
       return condjump(fs, OP_TEST, GETARG_B(ie), 0, !cond);
     }
     /* else go through */
@@ -1175,7 +1183,7 @@ void luaK_posfix (FuncState *fs, BinOpr op,
 ** Change line information associated with current position.
 */
 void luaK_fixline (FuncState *fs, int line) {
-  fs->f->lineinfo[fs->pc - 1] = line;
+  getline(fs, fs->pc - 1) = line;
 }
 
 
@@ -1201,3 +1209,280 @@ void luaK_setlist (FuncState *fs, int base, int nelems, int tostore) {
   fs->freereg = base + 1;  /* free registers with list values */
 }
 
+
+
+/*
+** {======================================================================
+** Inline expansion of calls to local functions
+** =======================================================================
+*/
+
+/* maximum size of an inline expansion */
+#define MAXINLINECODE	(2 * LUAI_MAXINLINE + 2)
+
+
+/*
+** Add constant 'v' (from another prototype) to the list of constants
+** and return its index.
+*/
+static int copyk (FuncState *fs, const TValue *v) {
+  switch (ttype(v)) {
+    case LUA_TNIL: return nilK(fs);
+    case LUA_TBOOLEAN: return boolK(fs, bvalue(v));
+    case LUA_TNUMINT: return luaK_intK(fs, ivalue(v));
+    case LUA_TNUMFLT: return luaK_numberK(fs, fltvalue(v));
+    default: {
+      lua_assert(ttisstring(v));
+      return luaK_stringK(fs, tsvalue(v));
+    }
+  }
+}
+
+
+/*
+** Translate R/K operand 'x' of prototype 'p' into an R/K operand of
+** the current function, whose register 0 is at register 'off'. Returns
+** -1 if the constant does not fit in an R/K operand.
+*/
+static int inlinerk (FuncState *fs, Proto *p, int x, int off) {
+  if (ISK(x)) {
+    int k = copyk(fs, &p->k[INDEXK(x)]);
+    return (k <= MAXINDEXRK) ? RKASK(k) : -1;
+  }
+  else
+    return x + off;
+}
+
+
+/*
+** Translate instruction 'i' of prototype 'p' so that it runs in the
+** frame of the current function, with the callee's register 0 at
+** register 'off'. Upvalues of 'p' must be variables of the current
+** function: upvalues in the stack become registers, others become
+** upvalues of the current function. Returns 0 if 'i' cannot be
+** translated or if it may raise an error or call a metamethod: an
+** expanded call has no frame of its own, so an error inside it would
+** be reported with the line and the variables of the caller.
+*/
+static int inlineinst (FuncState *fs, Proto *p, Instruction *i, int off) {
+  OpCode op = genericop(GET_OPCODE(*i));  /* 'p' has superinstructions */
+  int a = GETARG_A(*i) + off;
+  SET_OPCODE(*i, op);
+  switch (op) {
+    case OP_GETUPVAL: case OP_SETUPVAL: {
+      Upvaldesc *uv = &p->upvalues[GETARG_B(*i)];
+      if (!uv->instack)
+        *i = CREATE_ABC(op, a, uv->idx, 0);
+      else if (op == OP_GETUPVAL)
+        *i = CREATE_ABC(OP_MOVE, a, uv->idx, 0);
+      else  /* assignment to a local variable of the current function */
+        *i = CREATE_ABC(OP_MOVE, uv->idx, a, 0);
+      return 1;
+    }
+    case OP_LOADK: {
+      int k = copyk(fs, &p->k[GETARG_Bx(*i)]);
+      if (k > MAXARG_Bx) return 0;
+      *i = CREATE_ABx(OP_LOADK, a, k);
+      return 1;
+    }
+    case OP_JMP: {
+      if (GETARG_A(*i) != 0)  /* closes upvalues? */
+        SETARG_A(*i, a);
+      return 1;
+    }
+    case OP_SETLIST: {
+      if (GETARG_C(*i) == 0)  /* followed by an extra argument? */
+        return 0;
+      SETARG_A(*i, a);
+      return 1;
+    }
+    case OP_EQ: {  /* a constant operand rules out '__eq' */
+      int b = GETARG_B(*i), c = GETARG_C(*i);
+      if (!ISK(b) && !ISK(c)) return 0;
+      b = inlinerk(fs, p, b, off);
+      c = inlinerk(fs, p, c, off);
+      if (b < 0 || c < 0) return 0;
+      SETARG_B(*i, b);
+      SETARG_C(*i, c);
+      return 1;
+    }
+    case OP_MOVE: case OP_TESTSET: case OP_NOT: {
+      SETARG_A(*i, a);
+      SETARG_B(*i, GETARG_B(*i) + off);
+      return 1;
+    }
+    case OP_LOADBOOL: case OP_LOADNIL: case OP_TEST: case OP_NEWTABLE: {
+      SETARG_A(*i, a);
+      return 1;
+    }
+    default: {  /* arithmetic, indexing, calls, etc. */
+      return 0;
+    }
+  }
+}
+
+
+/*
+** Build in 'code' the inline expansion of the call at 'pc' to a function
+** with prototype 'p'. The callee's registers are placed right above the
+** called function (where a real call would place them), so that the
+** arguments are already in place. The expansion must be a single block
+** of straight code ending where the callee returns; jumps inside the
+** callee are relative, so they are kept unchanged. Returns the size of
+** the expansion or -1 if the call cannot be expanded.
+*/
+static int inlineexp (FuncState *fs, int pc, Proto *p, Instruction *code) {
+  Instruction call = fs->f->code[pc];
+  int base = GETARG_A(call);
+  int off = base + 1;  /* callee's register 0 */
+  int nargs = GETARG_B(call) - 1;
+  int nres = GETARG_C(call) - 1;
+  int nret = 0;  /* number of values returned by the callee */
+  int ret = 0;  /* first register returned by the callee */
+  int r, i, n = 0;
+  if (GET_OPCODE(call) != OP_CALL || nargs < 0 || nres < 0 || p->is_vararg ||
+      off + p->maxstacksize > MAXREGS)
+    return -1;
+  for (r = 0; GET_OPCODE(p->code[r]) != OP_RETURN; r++) ;
+  if (r > LUAI_MAXINLINE || nres + r + 2 > MAXINLINECODE)
+    return -1;
+  if (r == p->sizecode - 2) {  /* 'return' followed by final return? */
+    ret = GETARG_A(p->code[r]);
+    nret = GETARG_B(p->code[r]) - 1;
+    if (nret < 0) return -1;  /* multiple returns */
+  }
+  else if (r != p->sizecode - 1)  /* not the final return? */
+    return -1;
+  for (i = 0; i < r; i++) {  /* check that all paths reach the return */
+    OpCode op = GET_OPCODE(p->code[i]);
+    if (testTMode(op) || (op == OP_LOADBOOL && GETARG_C(p->code[i]))) {
+      if (i + 2 > r) return -1;  /* skips the return */
+    }
+    else if (getOpMode(op) == iAsBx) {
+      int dest = i + 1 + GETARG_sBx(p->code[i]);
+      if (dest < 0 || dest > r) return -1;
+    }
+  }
+  if (nargs < p->numparams)  /* missing arguments are nil */
+    code[n++] = CREATE_ABC(OP_LOADNIL, off + nargs,
+                           p->numparams - nargs - 1, 0);
+  for (i = 0; i < r; i++) {
+    code[n] = p->code[i];
+    if (!inlineinst(fs, p, &code[n++], off))
+      return -1;
+  }
+  for (i = 0; i < nres && i < nret; i++)  /* move results into place */
+    code[n++] = CREATE_ABC(OP_MOVE, base + i, off + ret + i, 0);
+  if (i < nres)  /* missing results are nil */
+    code[n++] = CREATE_ABC(OP_LOADNIL, base + i, nres - i - 1, 0);
+  return n;
+}
+
+
+/*
+** Replace the instruction at 'pc' by the 'n' instructions in 'code',
+** correcting jumps over that position and the ranges of local variables.
+*/
+static void replacecode (FuncState *fs, int pc, const Instruction *code,
+                         int n) {
+  lua_State *L = fs->ls->L;
+  Proto *f = fs->f;
+  Dyndata *dyd = fs->ls->dyd;
+  int delta = n - 1;
+  int line = getline(fs, pc);
+  int i;
+  lua_assert(dyd->lines.n == fs->firstline + fs->pc);
+  if (fs->pc + delta > f->sizecode) {
+    luaM_reallocvector(L, f->code, f->sizecode, fs->pc + delta, Instruction);
+    f->sizecode = fs->pc + delta;
+  }
+  if (dyd->lines.n + delta > dyd->lines.size) {
+    luaM_reallocvector(L, dyd->lines.arr, dyd->lines.size,
+                       dyd->lines.n + delta, int);
+    dyd->lines.size = dyd->lines.n + delta;
+  }
+  for (i = 0; i < fs->pc; i++) {  /* correct jumps */
+    Instruction *jmp = &f->code[i];
+    if (i != pc && getOpMode(GET_OPCODE(*jmp)) == iAsBx) {
+      int dest = i + 1 + GETARG_sBx(*jmp);
+      int newi = (i > pc) ? i + delta : i;
+      int newdest = (dest > pc) ? dest + delta : dest;
+      SETARG_sBx(*jmp, newdest - (newi + 1));
+    }
+  }
+  for (i = 0; i < fs->nlocvars; i++) {  /* correct variable ranges */
+    LocVar *var = &f->locvars[i];
+    if (var->startpc > pc) var->startpc += delta;
+    if (var->endpc > pc) var->endpc += delta;
+  }
+  memmove(f->code + pc + n, f->code + pc + 1,
+          (fs->pc - pc - 1) * sizeof(Instruction));
+  memmove(&getline(fs, pc + n), &getline(fs, pc + 1),
+          (fs->pc - pc - 1) * sizeof(int));
+  for (i = 0; i < n; i++) {
+    f->code[pc + i] = code[i];
+    getline(fs, pc + i) = line;  /* expansion "happens" in the call line */
+  }
+  fs->pc += delta;
+  dyd->lines.n += delta;
+}
+
+
+/*
+** Try to expand inline the call at 'pc' to a function with prototype
+** 'p'. The caller must ensure that the called variable always holds a
+** closure of 'p' and that 'p' is a function of the current one; the
+** closure itself is still created, so the variable keeps its value.
+*/
+void luaK_inline (FuncState *fs, int pc, Proto *p) {
+  Instruction code[MAXINLINECODE];
+  int n = inlineexp(fs, pc, p, code);
+  if (n >= 0) {
+    int needed = GETARG_A(fs->f->code[pc]) + 1 + p->maxstacksize;
+    if (needed > fs->f->maxstacksize)
+      fs->f->maxstacksize = cast_byte(needed);
+    replacecode(fs, pc, code, n);
+  }
+}
+
+/* }====================================================================== */
+
+
+/* limit for difference between lines in relative line info. */
+#define LIMLINEDIFF	0x80
+
+
+/*
+** Save the line information of the function being closed: each
+** instruction gets the difference from the line of the previous one
+** in a signed byte. Differences that do not fit, and at least one
+** instruction every MAXIWTHABS, get instead an entry with its absolute
+** line in 'abslineinfo' (see 'luaG_getfuncline').
+*/
+void luaK_finish (FuncState *fs) {
+  lua_State *L = fs->ls->L;
+  Proto *f = fs->f;
+  int previousline = f->linedefined;
+  int lastabs = -1;  /* position of last absolute line info */
+  int nabs = 0;
+  int pc;
+  luaM_reallocvector(L, f->lineinfo, f->sizelineinfo, fs->pc, ls_byte);
+  f->sizelineinfo = fs->pc;
+  for (pc = 0; pc < fs->pc; pc++) {
+    int line = getline(fs, pc);
+    int linedif = line - previousline;
+    if (abs(linedif) >= LIMLINEDIFF || pc - lastabs >= MAXIWTHABS) {
+      luaM_growvector(L, f->abslineinfo, nabs, f->sizeabslineinfo,
+                      AbsLineInfo, MAX_INT, "lines");
+      f->abslineinfo[nabs].pc = pc;
+      f->abslineinfo[nabs++].line = line;
+      linedif = ABSLINEINFO;  /* signal that there is absolute information */
+      lastabs = pc;
+    }
+    f->lineinfo[pc] = cast(ls_byte, linedif);
+    previousline = line;
+  }
+  luaM_reallocvector(L, f->abslineinfo, f->sizeabslineinfo, nabs, AbsLineInfo);
+  f->sizeabslineinfo = nabs;
+  fs->ls->dyd->lines.n = fs->firstline;  /* remove lines from the list */
+}
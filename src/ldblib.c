@@ -161,7 +161,7 @@ static int db_getinfo (lua_State *L) {
   }
   if (!lua_getinfo(L1, options, &ar))
     return luaL_argerror(L, arg+2, "invalid option");
-  lua_newtable(L);  /* table to collect results */
+  lua_createtable(L, 0, 2 * (int)strlen(options));  /* table for results */
   if (strchr(options, 'S')) {
     settabss(L, "source", ar.source);
     settabss(L, "short_src", ar.short_src);
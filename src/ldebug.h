@@ -13,11 +13,32 @@
 
 #define pcRel(pc, p)	(cast(int, (pc) - (p)->code) - 1)
 
-#define getfuncline(f,pc)	(((f)->lineinfo) ? (f)->lineinfo[pc] : -1)
-
 #define resethookcount(L)	(L->hookcount = L->basehookcount)
 
+/* internal mask for a sample requested by 'lua_sample' */
+#define MASKSAMPLE	(1 << (LUA_HOOKSAMPLE))
+
+/* masks that make the VM call 'luaG_traceexec' before an instruction */
+#define MASKTRACE	(LUA_MASKLINE | LUA_MASKCOUNT | MASKSAMPLE)
+
+
+/*
+** mark for entries in 'lineinfo' array that has absolute information in
+** 'abslineinfo' array
+*/
+#define ABSLINEINFO	(-0x80)
+
+
+/*
+** MAXimum number of successive Instructions WiTHout ABSolute line
+** information. (A power of two allows fast divisions.)
+*/
+#if !defined(MAXIWTHABS)
+#define MAXIWTHABS	128
+#endif
+
 
+LUAI_FUNC int luaG_getfuncline (const Proto *f, int pc);
 LUAI_FUNC l_noret luaG_typeerror (lua_State *L, const TValue *o,
                                                 const char *opname);
 LUAI_FUNC l_noret luaG_concaterror (lua_State *L, const TValue *p1,
@@ -246,12 +246,11 @@ void luaD_inctop (lua_State *L) {
 
 
 /*
-** Call a hook for the given event. Make sure there is a hook to be
-** called. (Both 'L->hook' and 'L->hookmask', which triggers this
-** function, can be changed asynchronously by signals.)
+** Call hook function 'hook' for the given event. Make sure there is a
+** hook to be called. (Both the hook and 'L->hookmask', which triggers
+** this function, can be changed asynchronously by signals.)
 */
-void luaD_hook (lua_State *L, int event, int line) {
-  lua_Hook hook = L->hook;
+static void callhookf (lua_State *L, lua_Hook hook, int event, int line) {
   if (hook && L->allowhook) {  /* make sure there is a hook */
     CallInfo *ci = L->ci;
     ptrdiff_t top = savestack(L, L->top);
@@ -277,6 +276,23 @@ void luaD_hook (lua_State *L, int event, int line) {
 }
 
 
+/*
+** Call a hook for the given event.
+*/
+void luaD_hook (lua_State *L, int event, int line) {
+  callhookf(L, L->hook, event, line);
+}
+
+
+/*
+** Call the sampler of a profiler (see 'lua_sample'). Like hooks, it
+** is not called while running a hook (or another sample).
+*/
+void luaD_sample (lua_State *L) {
+  callhookf(L, G(L)->sampler, LUA_HOOKSAMPLE, -1);
+}
+
+
 static void callhook (lua_State *L, CallInfo *ci) {
   int hook = LUA_HOOKCALL;
   ci->u.l.savedpc++;  /* hooks assume 'pc' is already incremented */
@@ -471,6 +487,42 @@ int luaD_precall (lua_State *L, StkId func, int nresults) {
 }
 
 
+/*
+** Prepares a tail call to the Lua function at 'func', with 'narg'
+** arguments, in place of the Lua function running in 'ci': the function
+** and its arguments are moved down to the start of the current frame,
+** which is then reused by the new call. This avoids a new CallInfo and
+** moving the whole new frame afterwards, which for a vararg function
+** means copying its fixed parameters twice. (Upvalues of the current
+** frame must be closed by the caller; if there is a call hook, tail
+** calls go through 'luaD_precall' instead.)
+*/
+void luaD_pretailcall (lua_State *L, CallInfo *ci, StkId func, int narg) {
+  Proto *p = clLvalue(func)->p;
+  int fsize = p->maxstacksize;  /* frame size */
+  StkId base;
+  int i;
+  lua_assert(isLua(ci) && ci == L->ci);
+  for (i = 0; i <= narg; i++)  /* move down function and arguments */
+    setobjs2s(L, ci->func + i, func + i);
+  func = ci->func;
+  L->top = func + 1 + narg;
+  checkstackp(L, fsize, func);
+  if (p->is_vararg)
+    base = adjust_varargs(L, p, narg);
+  else {  /* non vararg function */
+    for (; narg < p->numparams; narg++)
+      setnilvalue(L->top++);  /* complete missing arguments */
+    base = func + 1;
+  }
+  ci->u.l.base = base;
+  L->top = ci->top = base + fsize;
+  lua_assert(ci->top <= L->stack_last);
+  ci->u.l.savedpc = p->code;  /* starting point */
+  ci->callstatus |= CIST_TAIL;  /* function was tail called */
+}
+
+
 /*
 ** Check appropriate error for stack overflow ("regular" overflow or
 ** overflow while handling stack overflow). If 'nCalls' is larger than
@@ -648,6 +700,7 @@ static void resume (lua_State *L, void *ud) {
 LUA_API int lua_resume (lua_State *L, lua_State *from, int nargs) {
   int status;
   unsigned short oldnny = L->nny;  /* save "number of non-yieldable" calls */
+  lua_State *oldrunning = G(L)->running;
   lua_lock(L);
   if (L->status == LUA_OK) {  /* may be starting a coroutine */
     if (L->ci != &L->base_ci)  /* not in base level? */
@@ -661,6 +714,7 @@ LUA_API int lua_resume (lua_State *L, lua_State *from, int nargs) {
   luai_userstateresume(L, nargs);
   L->nny = 0;  /* allow yields */
   api_checknelems(L, (L->status == LUA_OK) ? nargs + 1 : nargs);
+  G(L)->running = L;
   status = luaD_rawrunprotected(L, resume, &nargs);
   if (status == -1)  /* error calling 'lua_resume'? */
     status = LUA_ERRRUN;
@@ -677,6 +731,7 @@ LUA_API int lua_resume (lua_State *L, lua_State *from, int nargs) {
     else lua_assert(status == L->status);  /* normal end or yield */
   }
   L->nny = oldnny;  /* restore 'nny' */
+  G(L)->running = oldrunning;
   L->nCcalls--;
   lua_assert(L->nCcalls == ((from) ? from->nCcalls : 0));
   lua_unlock(L);
@@ -769,7 +824,8 @@ static void f_parser (lua_State *L, void *ud) {
   int c = zgetc(p->z);  /* read first character */
   if (c == LUA_SIGNATURE[0]) {
     checkmode(L, p->mode, "binary");
-    cl = luaU_undump(L, p->z, p->name);
+    cl = luaU_undump(L, p->z, p->name,
+                     p->mode != NULL && strchr(p->mode, 'l') != NULL);
   }
   else {
     checkmode(L, p->mode, "text");
@@ -789,12 +845,16 @@ int luaD_protectedparser (lua_State *L, ZIO *z, const char *name,
   p.dyd.actvar.arr = NULL; p.dyd.actvar.size = 0;
   p.dyd.gt.arr = NULL; p.dyd.gt.size = 0;
   p.dyd.label.arr = NULL; p.dyd.label.size = 0;
+  p.dyd.inl.arr = NULL; p.dyd.inl.size = 0;
+  p.dyd.lines.arr = NULL; p.dyd.lines.size = 0;
   luaZ_initbuffer(L, &p.buff);
   status = luaD_pcall(L, f_parser, &p, savestack(L, L->top), L->errfunc);
   luaZ_freebuffer(L, &p.buff);
   luaM_freearray(L, p.dyd.actvar.arr, p.dyd.actvar.size);
   luaM_freearray(L, p.dyd.gt.arr, p.dyd.gt.size);
   luaM_freearray(L, p.dyd.label.arr, p.dyd.label.size);
+  luaM_freearray(L, p.dyd.inl.arr, p.dyd.inl.size);
+  luaM_freearray(L, p.dyd.lines.arr, p.dyd.lines.size);
   L->nny--;
   return status;
 }
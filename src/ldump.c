@@ -10,21 +10,30 @@
 #include "lprefix.h"
 
 
+#include <limits.h>
 #include <stddef.h>
+#include <string.h>
 
 #include "lua.h"
 
+#include "ldo.h"
+#include "lgc.h"
+#include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
+#include "ltable.h"
 #include "lundump.h"
+#include "lzio.h"
 
 
 typedef struct {
   lua_State *L;
-  lua_Writer writer;
-  void *data;
+  Mbuffer *out;  /* output buffer (NULL when only measuring) */
+  size_t size;  /* bytes dumped when only measuring */
+  Table *strings;  /* index of each string in the chunk, and vice versa */
+  int nstrings;
   int strip;
-  int status;
 } DumpState;
 
 
@@ -38,10 +47,19 @@ typedef struct {
 
 
 static void DumpBlock (const void *b, size_t size, DumpState *D) {
-  if (D->status == 0 && size > 0) {
-    lua_unlock(D->L);
-    D->status = (*D->writer)(D->L, b, size, D->data);
-    lua_lock(D->L);
+  Mbuffer *out = D->out;
+  if (out == NULL)  /* only measuring? */
+    D->size += size;
+  else if (size > 0) {
+    size_t n = luaZ_bufflen(out);
+    if (luaZ_sizebuffer(out) - n < size) {  /* not enough space? */
+      size_t newsize = luaZ_sizebuffer(out) * 2;
+      if (newsize - n < size)
+        newsize = n + size;
+      luaZ_resizebuffer(D->L, out, newsize);
+    }
+    memcpy(luaZ_buffer(out) + n, b, size);
+    luaZ_bufflen(out) = n + size;
   }
 }
 
@@ -55,8 +73,28 @@ static void DumpByte (int y, DumpState *D) {
 }
 
 
+/*
+** Sizes and other non-negative integers use a variable-length format:
+** 7 bits per byte, most significant first, with the high bit set only
+** in the last byte.
+*/
+#define DIBS	((sizeof(size_t) * CHAR_BIT + 6) / 7)
+
+static void DumpSize (size_t x, DumpState *D) {
+  lu_byte buff[DIBS];
+  int n = 0;
+  do {
+    buff[DIBS - (++n)] = x & 0x7f;  /* fill buffer in reverse order */
+    x >>= 7;
+  } while (x != 0);
+  buff[DIBS - 1] |= 0x80;  /* mark last byte */
+  DumpVector(buff + DIBS - n, n, D);
+}
+
+
 static void DumpInt (int x, DumpState *D) {
-  DumpVar(x, D);
+  lua_assert(x >= 0);
+  DumpSize(cast(size_t, x), D);
 }
 
 
@@ -70,30 +108,85 @@ static void DumpInteger (lua_Integer x, DumpState *D) {
 }
 
 
+/*
+** Strings are dumped once, in a table in front of all functions; each
+** use is dumped as its index in that table (0 for NULL).
+*/
 static void DumpString (const TString *s, DumpState *D) {
   if (s == NULL)
-    DumpByte(0, D);
+    DumpInt(0, D);
   else {
-    size_t size = tsslen(s) + 1;  /* include trailing '\0' */
-    const char *str = getstr(s);
-    if (size < 0xFF)
-      DumpByte(cast_int(size), D);
-    else {
-      DumpByte(0xFF, D);
-      DumpVar(size, D);
+    TValue key;
+    setsvalue(D->L, &key, cast(TString *, s));
+    DumpInt(cast_int(ivalue(luaH_get(D->strings, &key))), D);
+  }
+}
+
+
+static void AddString (TString *s, DumpState *D) {
+  if (s != NULL) {
+    TValue key, val;
+    setsvalue(D->L, &key, s);
+    if (ttisnil(luaH_get(D->strings, &key))) {  /* new string? */
+      setivalue(luaH_set(D->L, D->strings, &key), ++D->nstrings);
+      setsvalue(D->L, &val, s);
+      luaH_setint(D->L, D->strings, D->nstrings, &val);
     }
-    DumpVector(str, size - 1, D);  /* no need to save '\0' */
+  }
+}
+
+
+/*
+** Number all strings of 'f' and its nested functions, in the order
+** they will be dumped. Functions left unloaded by a lazy load are
+** decoded here, as their image refers to the strings of another chunk.
+*/
+static void AddStrings (Proto *f, TString *psource, DumpState *D) {
+  int i;
+  if (!D->strip && f->source != psource)
+    AddString(f->source, D);
+  for (i = 0; i < f->sizek; i++) {
+    if (ttisstring(&f->k[i]))
+      AddString(tsvalue(&f->k[i]), D);
+  }
+  for (i = 0; i < f->sizep; i++) {
+    if (luaU_islazy(f->p[i]))
+      luaU_loadproto(D->L, f, i);
+    AddStrings(f->p[i], f->source, D);
+  }
+  if (!D->strip) {
+    for (i = 0; i < f->sizelocvars; i++)
+      AddString(f->locvars[i].varname, D);
+    for (i = 0; i < f->sizeupvalues; i++)
+      AddString(f->upvalues[i].name, D);
+  }
+}
+
+
+static void DumpStrings (DumpState *D) {
+  int i;
+  DumpInt(D->nstrings, D);
+  for (i = 1; i <= D->nstrings; i++) {
+    const TString *s = tsvalue(luaH_getint(D->strings, i));
+    size_t size = tsslen(s);
+    DumpSize(size, D);
+    DumpVector(getstr(s), size, D);
   }
 }
 
 
 static void DumpCode (const Proto *f, DumpState *D) {
+  int i;
   DumpInt(f->sizecode, D);
-  DumpVector(f->code, f->sizecode, D);
+  for (i = 0; i < f->sizecode; i++) {
+    Instruction inst = f->code[i];
+    SET_OPCODE(inst, genericop(GET_OPCODE(inst)));  /* undo quickening */
+    DumpVar(inst, D);
+  }
 }
 
 
-static void DumpFunction(const Proto *f, TString *psource, DumpState *D);
+static void DumpSized (const Proto *f, TString *psource, DumpState *D);
 
 static void DumpConstants (const Proto *f, DumpState *D) {
   int i;
@@ -130,7 +223,7 @@ static void DumpProtos (const Proto *f, DumpState *D) {
   int n = f->sizep;
   DumpInt(n, D);
   for (i = 0; i < n; i++)
-    DumpFunction(f->p[i], f->source, D);
+    DumpSized(f->p[i], f->source, D);
 }
 
 
@@ -149,6 +242,12 @@ static void DumpDebug (const Proto *f, DumpState *D) {
   n = (D->strip) ? 0 : f->sizelineinfo;
   DumpInt(n, D);
   DumpVector(f->lineinfo, n, D);
+  n = (D->strip) ? 0 : f->sizeabslineinfo;
+  DumpInt(n, D);
+  for (i = 0; i < n; i++) {
+    DumpInt(f->abslineinfo[i].pc, D);
+    DumpInt(f->abslineinfo[i].line, D);
+  }
   n = (D->strip) ? 0 : f->sizelocvars;
   DumpInt(n, D);
   for (i = 0; i < n; i++) {
@@ -181,13 +280,33 @@ static void DumpFunction (const Proto *f, TString *psource, DumpState *D) {
 }
 
 
+/*
+** Dump a function preceded by its size, so that a lazy load can skip
+** it. The size comes from a dump with no output buffer, where nested
+** sizes are measured again.
+*/
+static void DumpSized (const Proto *f, TString *psource, DumpState *D) {
+  if (D->out == NULL) {  /* measuring? */
+    size_t size = D->size;
+    DumpFunction(f, psource, D);
+    DumpSize(D->size - size, D);
+  }
+  else {
+    DumpState M = *D;
+    M.out = NULL;
+    M.size = 0;
+    DumpFunction(f, psource, &M);
+    DumpSize(M.size, D);
+    DumpFunction(f, psource, D);
+  }
+}
+
+
 static void DumpHeader (DumpState *D) {
   DumpLiteral(LUA_SIGNATURE, D);
   DumpByte(LUAC_VERSION, D);
   DumpByte(LUAC_FORMAT, D);
   DumpLiteral(LUAC_DATA, D);
-  DumpByte(sizeof(int), D);
-  DumpByte(sizeof(size_t), D);
   DumpByte(sizeof(Instruction), D);
   DumpByte(sizeof(lua_Integer), D);
   DumpByte(sizeof(lua_Number), D);
@@ -197,19 +316,133 @@ static void DumpHeader (DumpState *D) {
 
 
 /*
-** dump Lua function as precompiled chunk
+** {======================================================
+** Compression: a greedy LZ77 over the chunk body. The result is a
+** sequence of literal runs (size plus bytes), each one followed by a
+** match (size minus LUAC_MINMATCH plus distance back), except the
+** last one.
+** =======================================================
 */
-int luaU_dump(lua_State *L, const Proto *f, lua_Writer w, void *data,
-              int strip) {
+
+#define HASHBITS	14
+
+#define hashpos(p) \
+  (((unsigned int)cast_uchar((p)[0]) | (unsigned int)cast_uchar((p)[1]) << 8 | \
+    (unsigned int)cast_uchar((p)[2]) << 16 | \
+    (unsigned int)cast_uchar((p)[3]) << 24) * 2654435761u >> (32 - HASHBITS))
+
+
+static void Compress (const char *s, size_t n, size_t *last,
+                      DumpState *D) {
+  size_t lit = 0;  /* start of current literal run */
+  size_t i = 0;
+  memset(last, 0, sizeof(size_t) << HASHBITS);
+  DumpSize(n, D);
+  while (n - i >= LUAC_MINMATCH) {
+    unsigned int h = hashpos(s + i) & ((1u << HASHBITS) - 1);
+    size_t m = last[h];  /* last position with the same hash (plus 1) */
+    last[h] = i + 1;
+    if (m > 0 && memcmp(s + m - 1, s + i, LUAC_MINMATCH) == 0) {
+      size_t len = LUAC_MINMATCH;
+      m--;
+      while (i + len < n && s[m + len] == s[i + len])
+        len++;
+      DumpSize(i - lit, D);
+      DumpBlock(s + lit, i - lit, D);
+      DumpSize(len - LUAC_MINMATCH, D);
+      DumpSize(i - m, D);
+      i += len;
+      lit = i;
+    }
+    else
+      i++;
+  }
+  if (lit < n) {  /* final literals */
+    DumpSize(n - lit, D);
+    DumpBlock(s + lit, n - lit, D);
+  }
+}
+
+/* }====================================================== */
+
+
+struct SDump {  /* data to 'f_dump' */
+  Proto *f;
+  lua_Writer writer;
+  void *data;
+  int opts;
+  int status;
+  Mbuffer body;  /* chunk after its header */
+  Mbuffer out;  /* whole chunk */
+  Mbuffer hash;  /* hash table for compression */
+};
+
+
+static void f_dump (lua_State *L, void *ud) {
+  struct SDump *d = cast(struct SDump *, ud);
+  Mbuffer *out = &d->out;
   DumpState D;
   D.L = L;
-  D.writer = w;
-  D.data = data;
-  D.strip = strip;
-  D.status = 0;
+  D.size = 0;
+  D.strip = (d->opts & LUA_DUMPSTRIP);
+  D.nstrings = 0;
+  D.strings = luaH_new(L);
+  sethvalue(L, L->top, D.strings);  /* anchor it */
+  luaD_inctop(L);
+  AddStrings(d->f, NULL, &D);
+  D.out = &d->body;
+  DumpByte(d->f->sizeupvalues, &D);
+  DumpStrings(&D);
+  DumpSized(d->f, NULL, &D);
+  L->top--;  /* remove string table */
+  D.out = out;
   DumpHeader(&D);
-  DumpByte(f->sizeupvalues, &D);
-  DumpFunction(f, NULL, &D);
-  return D.status;
+  if (d->opts & LUA_DUMPCOMPRESS) {
+    size_t n = luaZ_bufflen(out);
+    DumpByte(LUAC_COMPRESSED, &D);
+    luaZ_resizebuffer(L, &d->hash, sizeof(size_t) << HASHBITS);
+    Compress(luaZ_buffer(&d->body), luaZ_bufflen(&d->body),
+             cast(size_t *, luaZ_buffer(&d->hash)), &D);
+    if (luaZ_bufflen(out) - n <= luaZ_bufflen(&d->body))  /* any gain? */
+      luaZ_resetbuffer(&d->body);  /* body is already in 'out' */
+    else
+      luaZ_bufflen(out) = n;  /* store it plain */
+  }
+  if (luaZ_bufflen(&d->body) > 0)  /* plain body? */
+    DumpByte(LUAC_PLAIN, &D);
+  lua_unlock(L);
+  d->status = (*d->writer)(L, luaZ_buffer(out), luaZ_bufflen(out), d->data);
+  if (d->status == 0 && luaZ_bufflen(&d->body) > 0)
+    d->status = (*d->writer)(L, luaZ_buffer(&d->body),
+                                luaZ_bufflen(&d->body), d->data);
+  lua_lock(L);
 }
 
+
+/*
+** dump Lua function as precompiled chunk; the chunk is built in memory
+** (in protected mode, to free its buffers in case of errors) and then
+** given to the writer
+*/
+int luaU_dump(lua_State *L, const Proto *f, lua_Writer w, void *data,
+              int opts) {
+  struct SDump d;
+  int status;
+  d.f = cast(Proto *, f);
+  d.writer = w;
+  d.data = data;
+  d.opts = opts;
+  d.status = 0;
+  luaZ_initbuffer(L, &d.body);
+  luaZ_initbuffer(L, &d.out);
+  luaZ_initbuffer(L, &d.hash);
+  luaZ_resetbuffer(&d.body);
+  luaZ_resetbuffer(&d.out);
+  status = luaD_pcall(L, f_dump, &d, savestack(L, L->top), L->errfunc);
+  luaZ_freebuffer(L, &d.body);
+  luaZ_freebuffer(L, &d.out);
+  luaZ_freebuffer(L, &d.hash);
+  if (status != LUA_OK)
+    luaD_throw(L, status);  /* propagate error */
+  return d.status;
+}
@@ -107,6 +107,29 @@ static void reallymarkobject (global_State *g, GCObject *o);
 #define gnodelast(h)	gnode(h, cast(size_t, sizenode(h)))
 
 
+/*
+** During an incremental resize, a table also has nodes in its old hash
+** part. When a traversal reaches the end of the hash part, 'oldnodes'
+** moves it to the old one (if there is one).
+*/
+static int oldnodes (Table *h, Node **n, Node **limit) {
+  if (h->oldnode == NULL || *limit != gnodelast(h))
+    return 0;  /* no old nodes or already traversed them */
+  *n = h->oldnode;
+  *limit = h->oldnode + allocsizeoldnode(h);
+  return 1;
+}
+
+
+/*
+** traverse all nodes of table 'h', in its hash part and in its old
+** hash part
+*/
+#define fornodes(h,n,limit) \
+  for (n = gnode(h, 0), limit = gnodelast(h); \
+       n < limit || oldnodes(h, &n, &limit); n++)
+
+
 /*
 ** link collectable object 'o' into list pointed by 'p'
 */
@@ -359,11 +382,11 @@ static void restartcollection (global_State *g) {
 ** put it in 'weak' list, to be cleared.
 */
 static void traverseweakvalue (global_State *g, Table *h) {
-  Node *n, *limit = gnodelast(h);
+  Node *n, *limit;
   /* if there is array part, assume it may have white values (it is not
      worth traversing it now just to check) */
-  int hasclears = (h->sizearray > 0);
-  for (n = gnode(h, 0); n < limit; n++) {  /* traverse hash part */
+  int hasclears = (sizetvarray(h) > 0);
+  fornodes(h, n, limit) {  /* traverse hash part */
     checkdeadkey(n);
     if (ttisnil(gval(n)))  /* entry is empty? */
       removeentry(n);  /* remove it */
@@ -395,17 +418,17 @@ static int traverseephemeron (global_State *g, Table *h) {
   int marked = 0;  /* true if an object is marked in this traversal */
   int hasclears = 0;  /* true if table has white keys */
   int hasww = 0;  /* true if table has entry "white-key -> white-value" */
-  Node *n, *limit = gnodelast(h);
+  Node *n, *limit;
   unsigned int i;
   /* traverse array part */
-  for (i = 0; i < h->sizearray; i++) {
+  for (i = 0; i < sizetvarray(h); i++) {
     if (valiswhite(&h->array[i])) {
       marked = 1;
       reallymarkobject(g, gcvalue(&h->array[i]));
     }
   }
   /* traverse hash part */
-  for (n = gnode(h, 0); n < limit; n++) {
+  fornodes(h, n, limit) {
     checkdeadkey(n);
     if (ttisnil(gval(n)))  /* entry is empty? */
       removeentry(n);  /* remove it */
@@ -431,11 +454,11 @@ static int traverseephemeron (global_State *g, Table *h) {
 
 
 static void traversestrongtable (global_State *g, Table *h) {
-  Node *n, *limit = gnodelast(h);
+  Node *n, *limit;
   unsigned int i;
-  for (i = 0; i < h->sizearray; i++)  /* traverse array part */
+  for (i = 0; i < sizetvarray(h); i++)  /* traverse array part */
     markvalue(g, &h->array[i]);
-  for (n = gnode(h, 0); n < limit; n++) {  /* traverse hash part */
+  fornodes(h, n, limit) {  /* traverse hash part */
     checkdeadkey(n);
     if (ttisnil(gval(n)))  /* entry is empty? */
       removeentry(n);  /* remove it */
@@ -448,13 +471,26 @@ static void traversestrongtable (global_State *g, Table *h) {
 }
 
 
+/*
+** Check whether mode string 'ts' has option 'c' (before any '\0'). (The
+** bytes of a long string may not be followed by a '\0'.)
+*/
+static int hasmode (TString *ts, int c) {
+  const char *s = getstr(ts);
+  size_t l = tsslen(ts);
+  const char *z = cast(const char *, memchr(s, '\0', l));
+  if (z != NULL) l = z - s;
+  return (memchr(s, c, l) != NULL);
+}
+
+
 static lu_mem traversetable (global_State *g, Table *h) {
-  const char *weakkey, *weakvalue;
+  int weakkey, weakvalue;
   const TValue *mode = gfasttm(g, h->metatable, TM_MODE);
   markobjectN(g, h->metatable);
   if (mode && ttisstring(mode) &&  /* is there a weak mode? */
-      ((weakkey = strchr(svalue(mode), 'k')),
-       (weakvalue = strchr(svalue(mode), 'v')),
+      ((weakkey = hasmode(tsvalue(mode), 'k')),
+       (weakvalue = hasmode(tsvalue(mode), 'v')),
        (weakkey || weakvalue))) {  /* is really weak? */
     black2gray(h);  /* keep table gray */
     if (!weakkey)  /* strong keys? */
@@ -466,8 +502,9 @@ static lu_mem traversetable (global_State *g, Table *h) {
   }
   else  /* not weak */
     traversestrongtable(g, h);
-  return sizeof(Table) + sizeof(TValue) * h->sizearray +
-                         sizeof(Node) * cast(size_t, allocsizenode(h));
+  return sizeof(Table) + arraymem(h) +
+                         sizeof(Node) * cast(size_t, allocsizenode(h)) +
+                         sizeof(Node) * cast(size_t, allocsizeoldnode(h));
 }
 
 
@@ -478,9 +515,12 @@ static lu_mem traversetable (global_State *g, Table *h) {
 */
 static int traverseproto (global_State *g, Proto *f) {
   int i;
-  if (f->cache && iswhite(f->cache))
-    f->cache = NULL;  /* allow cache to be collected */
+  for (i = 0; i < LUAI_NCLCACHE; i++) {
+    if (f->cache[i] && iswhite(f->cache[i]))
+      f->cache[i] = NULL;  /* allow cache to be collected */
+  }
   markobjectN(g, f->source);
+  markobjectN(g, f->image);
   for (i = 0; i < f->sizek; i++)  /* mark literals */
     markvalue(g, &f->k[i]);
   for (i = 0; i < f->sizeupvalues; i++)  /* mark upvalue names */
@@ -490,9 +530,11 @@ static int traverseproto (global_State *g, Proto *f) {
   for (i = 0; i < f->sizelocvars; i++)  /* mark local-variable names */
     markobjectN(g, f->locvars[i].varname);
   return sizeof(Proto) + sizeof(Instruction) * f->sizecode +
+                         sizeof(unsigned int) * f->sizecode +
                          sizeof(Proto *) * f->sizep +
                          sizeof(TValue) * f->sizek +
-                         sizeof(int) * f->sizelineinfo +
+                         sizeof(ls_byte) * f->sizelineinfo +
+                         sizeof(AbsLineInfo) * f->sizeabslineinfo +
                          sizeof(LocVar) * f->sizelocvars +
                          sizeof(Upvaldesc) * f->sizeupvalues;
 }
@@ -639,8 +681,8 @@ static void convergeephemerons (global_State *g) {
 static void clearkeys (global_State *g, GCObject *l, GCObject *f) {
   for (; l != f; l = gco2t(l)->gclist) {
     Table *h = gco2t(l);
-    Node *n, *limit = gnodelast(h);
-    for (n = gnode(h, 0); n < limit; n++) {
+    Node *n, *limit;
+    fornodes(h, n, limit) {
       if (!ttisnil(gval(n)) && (iscleared(g, gkey(n)))) {
         setnilvalue(gval(n));  /* remove value ... */
         removeentry(n);  /* and remove entry from table */
@@ -657,14 +699,14 @@ static void clearkeys (global_State *g, GCObject *l, GCObject *f) {
 static void clearvalues (global_State *g, GCObject *l, GCObject *f) {
   for (; l != f; l = gco2t(l)->gclist) {
     Table *h = gco2t(l);
-    Node *n, *limit = gnodelast(h);
+    Node *n, *limit;
     unsigned int i;
-    for (i = 0; i < h->sizearray; i++) {
+    for (i = 0; i < sizetvarray(h); i++) {
       TValue *o = &h->array[i];
       if (iscleared(g, o))  /* value was collected? */
         setnilvalue(o);  /* remove value */
     }
-    for (n = gnode(h, 0); n < limit; n++) {
+    fornodes(h, n, limit) {
       if (!ttisnil(gval(n)) && iscleared(g, gval(n))) {
         setnilvalue(gval(n));  /* remove value ... */
         removeentry(n);  /* and remove entry from table */
@@ -712,7 +754,7 @@ static void freeobj (lua_State *L, GCObject *o) {
       luaM_freemem(L, o, sizelstring(gco2ts(o)->shrlen));
       break;
     case LUA_TLNGSTR: {
-      luaM_freemem(L, o, sizelstring(gco2ts(o)->u.lnglen));
+      luaS_freelngstr(L, gco2ts(o));
       break;
     }
     default: lua_assert(0);
@@ -772,12 +814,20 @@ static GCObject **sweeptolive (lua_State *L, GCObject **p) {
 */
 
 /*
-** If possible, shrink string table
+** If possible, shrink string table (down to its initial size). The
+** shrink load is kept under half the grow load, so that a table just
+** shrunk does not grow back at once.
 */
 static void checkSizes (lua_State *L, global_State *g) {
   if (g->gckind != KGC_EMERGENCY) {
     l_mem olddebt = g->GCdebt;
-    if (g->strt.nuse < g->strt.size / 4)  /* string table too big? */
+    stringtable *tb = &g->strt;
+    lu_mem shrink = cast(lu_mem, tb->shrink);
+    if (shrink * 2 >= cast(lu_mem, tb->grow))
+      shrink = (tb->grow - 1) / 2;
+    if (tb->size > MINSTRTABSIZE &&
+        cast(lu_mem, tb->nuse) * 100 <
+        cast(lu_mem, tb->size) * shrink)  /* string table too big? */
       luaS_resize(L, g->strt.size / 2);  /* shrink it a little */
     g->GCestimate += g->GCdebt - olddebt;  /* update estimate */
   }
@@ -826,7 +876,7 @@ static void GCTM (lua_State *L, int propagateerrors) {
     if (status != LUA_OK && propagateerrors) {  /* error while running __gc? */
       if (status == LUA_ERRRUN) {  /* is there an error object? */
         const char *msg = (ttisstring(L->top - 1))
-                            ? svalue(L->top - 1)
+                            ? luaS_terminate(L, tsvalue(L->top - 1))
                             : "no message";
         luaO_pushfstring(L, "error in __gc metamethod (%s)", msg);
         status = LUA_ERRGCMM;  /* error in __gc metamethod */
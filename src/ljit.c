@@ -0,0 +1,763 @@
+/*
+** $Id: ljit.c $
+** Baseline JIT compiler for x86-64
+** See Copyright Notice in lua.h
+*/
+
+#define ljit_c
+#define LUA_CORE
+
+/* 'MAP_ANONYMOUS' is not part of the POSIX subset asked by 'lprefix.h' */
+#if !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include "lprefix.h"
+
+
+#include <stddef.h>
+
+#include "lua.h"
+
+#include "lfunc.h"
+#include "lgc.h"
+#include "ljit.h"
+#include "lmem.h"
+#include "lobject.h"
+#include "lopcodes.h"
+#include "lstate.h"
+#include "ltable.h"
+#include "lvm.h"
+
+
+#if LUA_USE_JIT		/* { */
+
+#include <sys/mman.h>
+
+
+/*
+** The compiler translates a whole hot function, instruction by
+** instruction, into a copy of a machine-code template for each opcode.
+** Templates cover only the common cases of their instructions (e.g.,
+** arithmetic over two integers or two floats); in all other cases, and
+** for opcodes without templates, the native code "exits": it saves the
+** current instruction in 'savedpc' and returns to 'luaV_execute', which
+** executes that instruction. The interpreter enters native code again
+** when it (re)starts a frame and at backward jumps.
+**
+** Native code keeps all Lua values in the stack, so that errors and
+** yields raised inside its calls to C (table accesses) can simply discard
+** it; these calls save 'savedpc' before, as the interpreter does. Native
+** code also checks 'hookmask' after these calls and at backward jumps,
+** and leaves to the interpreter when there are hooks to run.
+*/
+
+
+/* native code of a function */
+typedef struct JitCode {
+  void (*run) (lua_State *L, CallInfo *ci, const void *target);
+  unsigned char *mcode;  /* machine code */
+  size_t size;  /* size of 'mcode' */
+  int *entry;  /* offset in 'mcode' of each instruction (-1 if none) */
+  int *offs;  /* positions used by the code generator (owns 'entry') */
+  int sizeoffs;
+} JitCode;
+
+
+/* state of the code generator */
+typedef struct JitState {
+  unsigned char *code;  /* code being generated (NULL in first pass) */
+  int pos;  /* current position in 'code' */
+  int epilogue;  /* position of the code that returns to the interpreter */
+  int *pcoff;  /* position of each instruction */
+  int *exitoff;  /* position of exit for each instruction (-1 if none) */
+  int *backoff;  /* position of backward jump to each instruction (idem) */
+  int *entry;  /* position of native code for each instruction (idem) */
+  Proto *p;
+} JitState;
+
+
+/* x86-64 registers */
+#define RAX	0
+#define RCX	1
+#define RDX	2
+#define RBX	3
+#define R12	12
+#define R13	13
+#define R14	14
+#define R15	15
+
+/* registers used by native code */
+#define BASE	RBX	/* base of current function */
+#define LSTATE	R12	/* 'lua_State' */
+#define CINFO	R13	/* 'CallInfo' of current function */
+#define KST	R14	/* constants of current function */
+#define CLOSURE	R15	/* closure of current function */
+
+/* condition codes */
+#define CC_B	0x2
+#define CC_AE	0x3
+#define CC_E	0x4
+#define CC_NE	0x5
+#define CC_BE	0x6
+#define CC_A	0x7
+#define CC_P	0xA
+#define CC_L	0xC
+#define CC_GE	0xD
+#define CC_LE	0xE
+#define CC_G	0xF
+#define CC_ALWAYS	(-1)
+
+#define negcc(c)	((c) ^ 1)
+
+#define TVSIZE		cast_int(sizeof(TValue))
+#define TAG		cast_int(offsetof(TValue, tt_))
+
+/* position in memory of register 'r' and of constant 'k' */
+#define REG(r)		(TVSIZE * (r))
+#define KST_(k)		(TVSIZE * (k))
+
+#define SAVEDPC		cast_int(offsetof(CallInfo, u.l.savedpc))
+
+
+static void byte (JitState *J, int b) {
+  if (J->code)
+    J->code[J->pos] = cast(unsigned char, b);
+  J->pos++;
+}
+
+
+static void dword (JitState *J, unsigned int d) {
+  int i;
+  for (i = 0; i < 4; i++, d >>= 8)
+    byte(J, d & 0xFF);
+}
+
+
+static void qword (JitState *J, size_t q) {
+  int i;
+  for (i = 0; i < 8; i++, q >>= 8)
+    byte(J, cast_int(q & 0xFF));
+}
+
+
+/*
+** Emits instruction 'op' (one or two bytes, after an optional 'prefix')
+** with operands register 'reg' and memory '[base + disp]'; 'w' asks for
+** 64-bit operands.
+*/
+static void opmem (JitState *J, int prefix, int w, int op, int reg,
+                   int base, int disp) {
+  int rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (base >> 3);
+  if (prefix) byte(J, prefix);
+  if (rex != 0x40) byte(J, rex);
+  if (op > 0xFF) byte(J, op >> 8);
+  byte(J, op & 0xFF);
+  byte(J, 0x80 | ((reg & 7) << 3) | (base & 7));  /* [base + disp32] */
+  if ((base & 7) == 4) byte(J, 0x24);  /* SIB for RSP/R12 */
+  dword(J, cast(unsigned int, disp));
+}
+
+
+/* instruction 'op' with two register operands */
+static void opreg (JitState *J, int w, int op, int reg, int rm) {
+  int rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+  if (rex != 0x40) byte(J, rex);
+  byte(J, op);
+  byte(J, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+
+#define loadq(J,r,b,d)	opmem(J, 0, 1, 0x8B, r, b, d)
+#define storeq(J,r,b,d)	opmem(J, 0, 1, 0x89, r, b, d)
+#define loadd(J,r,b,d)	opmem(J, 0, 0, 0x8B, r, b, d)
+#define stored(J,r,b,d)	opmem(J, 0, 0, 0x89, r, b, d)
+#define loadsd(J,x,b,d)	opmem(J, 0xF2, 0, 0x0F10, x, b, d)
+#define storesd(J,x,b,d)	opmem(J, 0xF2, 0, 0x0F11, x, b, d)
+
+
+/* mov dword [base + disp], imm */
+static void storeimm (JitState *J, int base, int disp, unsigned int imm) {
+  opmem(J, 0, 0, 0xC7, 0, base, disp);
+  dword(J, imm);
+}
+
+
+/* cmp dword [base + disp], imm */
+static void cmpimm (JitState *J, int base, int disp, unsigned int imm) {
+  opmem(J, 0, 0, 0x81, 7, base, disp);
+  dword(J, imm);
+}
+
+
+/* mov reg, imm64 */
+static void loadimm (JitState *J, int reg, size_t imm) {
+  byte(J, 0x48 | (reg >> 3));
+  byte(J, 0xB8 | (reg & 7));
+  qword(J, imm);
+}
+
+
+/* copy a TValue from '[b + d]' to '[b1 + d1]' (using RCX and RDX) */
+static void copytv (JitState *J, int b1, int d1, int b, int d) {
+  loadq(J, RCX, b, d);
+  loadq(J, RDX, b, d + 8);
+  storeq(J, RCX, b1, d1);
+  storeq(J, RDX, b1, d1 + 8);
+}
+
+
+/*
+** Jumps to position 'target' if condition 'cc' holds (always if 'cc'
+** is CC_ALWAYS).
+*/
+static void jumpto (JitState *J, int cc, int target) {
+  if (cc == CC_ALWAYS) {
+    byte(J, 0xE9);
+    dword(J, cast(unsigned int, target - (J->pos + 4)));
+  }
+  else {
+    byte(J, 0x0F);
+    byte(J, 0x80 | cc);
+    dword(J, cast(unsigned int, target - (J->pos + 4)));
+  }
+}
+
+
+/*
+** Forward jump to a position not known yet; returns the position to be
+** given to 'patchhere'.
+*/
+static int jumpfwd (JitState *J, int cc) {
+  jumpto(J, cc, J->pos);
+  return J->pos - 4;
+}
+
+
+static void patchhere (JitState *J, int pos) {
+  if (J->code) {
+    unsigned int d = cast(unsigned int, J->pos - (pos + 4));
+    int i;
+    for (i = 0; i < 4; i++, d >>= 8)
+      J->code[pos + i] = cast(unsigned char, d & 0xFF);
+  }
+}
+
+
+/* leaves to the interpreter, which will execute instruction 'pc' */
+static void jumpexit (JitState *J, int cc, int pc) {
+  if (J->exitoff[pc] < 0) J->exitoff[pc] = 0;  /* mark it as needed */
+  jumpto(J, cc, J->exitoff[pc]);
+}
+
+
+/*
+** Jumps to instruction 'target' from instruction 'pc'; a backward jump
+** goes through a check for hooks.
+*/
+static void jumppc (JitState *J, int cc, int pc, int target) {
+  if (target > pc)
+    jumpto(J, cc, J->pcoff[target]);
+  else {
+    if (J->backoff[target] < 0) J->backoff[target] = 0;  /* mark it */
+    jumpto(J, cc, J->backoff[target]);
+  }
+}
+
+
+/* code for instruction 'pc' to leave to the interpreter */
+static void genexit (JitState *J, int pc) {
+  loadimm(J, RAX, cast(size_t, J->p->code + pc));
+  storeq(J, RAX, CINFO, SAVEDPC);
+  jumpto(J, CC_ALWAYS, J->epilogue);
+}
+
+
+/* position in memory of register/constant 'x' */
+static void rkpos (int x, int *base, int *disp) {
+  if (ISK(x)) { *base = KST; *disp = KST_(INDEXK(x)); }
+  else { *base = BASE; *disp = REG(x); }
+}
+
+
+/*
+** Calls C function 'f' as 'f(L, i)' for instruction 'i' at 'pc'.
+** 'f' can run any Lua code, so native code must reload its base after
+** it and leave if that code set hooks.
+*/
+static void gencall (JitState *J, void (*f) (lua_State *, Instruction),
+                     Instruction i, int pc) {
+  loadimm(J, RAX, cast(size_t, J->p->code + pc + 1));
+  storeq(J, RAX, CINFO, SAVEDPC);
+  opreg(J, 1, 0x89, LSTATE, 7);  /* mov rdi, L */
+  byte(J, 0xBE); dword(J, i);  /* mov esi, i */
+  loadimm(J, RAX, cast(size_t, f));
+  byte(J, 0xFF); byte(J, 0xD0);  /* call rax */
+  loadq(J, BASE, CINFO, cast_int(offsetof(CallInfo, u.l.base)));
+  cmpimm(J, LSTATE, cast_int(offsetof(lua_State, hookmask)), 0);
+  jumpexit(J, CC_NE, pc + 1);
+}
+
+
+static void jit_gettable (lua_State *L, Instruction i) {
+  CallInfo *ci = L->ci;
+  StkId base = ci->u.l.base;
+  LClosure *cl = clLvalue(ci->func);
+  TValue *t = (GET_OPCODE(i) == OP_GETTABUP) ? cl->upvals[GETARG_B(i)]->v
+                                             : base + GETARG_B(i);
+  TValue *key = ISK(GETARG_C(i)) ? cl->p->k + INDEXK(GETARG_C(i))
+                                 : base + GETARG_C(i);
+  luaV_gettable(L, t, key, base + GETARG_A(i));
+}
+
+
+static void jit_settable (lua_State *L, Instruction i) {
+  CallInfo *ci = L->ci;
+  StkId base = ci->u.l.base;
+  LClosure *cl = clLvalue(ci->func);
+  TValue *t = (GET_OPCODE(i) == OP_SETTABUP) ? cl->upvals[GETARG_A(i)]->v
+                                             : base + GETARG_A(i);
+  TValue *key = ISK(GETARG_B(i)) ? cl->p->k + INDEXK(GETARG_B(i))
+                                 : base + GETARG_B(i);
+  TValue *val = ISK(GETARG_C(i)) ? cl->p->k + INDEXK(GETARG_C(i))
+                                 : base + GETARG_C(i);
+  luaV_settable(L, t, key, val);
+}
+
+
+/* OP_ADD, OP_SUB, OP_MUL over two integers or two floats */
+static void genarith (JitState *J, int pc, Instruction i, int iop, int fop) {
+  int a = REG(GETARG_A(i));
+  int bb, bd, cb, cd;
+  int flt, done;
+  rkpos(GETARG_B(i), &bb, &bd);
+  rkpos(GETARG_C(i), &cb, &cd);
+  loadd(J, RAX, bb, bd + TAG);
+  opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TNUMINT);  /* cmp eax, imm */
+  flt = jumpfwd(J, CC_NE);
+  cmpimm(J, cb, cd + TAG, LUA_TNUMINT);
+  jumpexit(J, CC_NE, pc);
+  loadq(J, RAX, bb, bd);
+  opmem(J, 0, 1, iop, RAX, cb, cd);
+  storeq(J, RAX, BASE, a);
+  storeimm(J, BASE, a + TAG, LUA_TNUMINT);
+  done = jumpfwd(J, CC_ALWAYS);
+  patchhere(J, flt);
+  opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TNUMFLT);
+  jumpexit(J, CC_NE, pc);
+  cmpimm(J, cb, cd + TAG, LUA_TNUMFLT);
+  jumpexit(J, CC_NE, pc);
+  loadsd(J, 0, bb, bd);
+  opmem(J, 0xF2, 0, fop, 0, cb, cd);
+  storesd(J, 0, BASE, a);
+  storeimm(J, BASE, a + TAG, LUA_TNUMFLT);
+  patchhere(J, done);
+}
+
+
+/* OP_MOD over two integers (as 'luaV_mod'), but not by 0 */
+static void genmod (JitState *J, int pc, Instruction i) {
+  int a = REG(GETARG_A(i));
+  int bb, bd, cb, cd;
+  int minus1, zero, done1, done2;
+  rkpos(GETARG_B(i), &bb, &bd);
+  rkpos(GETARG_C(i), &cb, &cd);
+  cmpimm(J, bb, bd + TAG, LUA_TNUMINT);
+  jumpexit(J, CC_NE, pc);
+  cmpimm(J, cb, cd + TAG, LUA_TNUMINT);
+  jumpexit(J, CC_NE, pc);
+  loadq(J, RCX, cb, cd);
+  opreg(J, 1, 0x85, RCX, RCX);  /* test rcx, rcx */
+  jumpexit(J, CC_E, pc);  /* let the interpreter raise the error */
+  opreg(J, 1, 0x83, 7, RCX); byte(J, 0xFF);  /* cmp rcx, -1 */
+  minus1 = jumpfwd(J, CC_E);
+  loadq(J, RAX, bb, bd);
+  byte(J, 0x48); byte(J, 0x99);  /* cqo */
+  opreg(J, 1, 0xF7, 7, RCX);  /* idiv rcx: remainder in rdx */
+  opreg(J, 1, 0x85, RDX, RDX);
+  zero = jumpfwd(J, CC_E);
+  opreg(J, 1, 0x89, RDX, RAX);  /* mov rax, rdx */
+  opreg(J, 1, 0x31, RCX, RAX);  /* xor rax, rcx */
+  done1 = jumpfwd(J, CC_GE);  /* same signs? */
+  opreg(J, 1, 0x01, RCX, RDX);  /* add rdx, rcx */
+  done2 = jumpfwd(J, CC_ALWAYS);
+  patchhere(J, minus1);
+  opreg(J, 0, 0x31, RDX, RDX);  /* 'm % -1' is 0 */
+  patchhere(J, zero);
+  patchhere(J, done1);
+  patchhere(J, done2);
+  storeq(J, RDX, BASE, a);
+  storeimm(J, BASE, a + TAG, LUA_TNUMINT);
+}
+
+
+/* loads number at '[base + disp]' as a float into register 'xmm' */
+static void loadnumber (JitState *J, int pc, int xmm, int base, int disp) {
+  int notint, done;
+  loadd(J, RAX, base, disp + TAG);
+  opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TNUMINT);
+  notint = jumpfwd(J, CC_NE);
+  opmem(J, 0xF2, 1, 0x0F2A, xmm, base, disp);  /* cvtsi2sd xmm, [m] */
+  done = jumpfwd(J, CC_ALWAYS);
+  patchhere(J, notint);
+  opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TNUMFLT);
+  jumpexit(J, CC_NE, pc);
+  loadsd(J, xmm, base, disp);
+  patchhere(J, done);
+}
+
+
+/* OP_DIV over numbers */
+static void gendiv (JitState *J, int pc, Instruction i) {
+  int a = REG(GETARG_A(i));
+  int bb, bd, cb, cd;
+  rkpos(GETARG_B(i), &bb, &bd);
+  rkpos(GETARG_C(i), &cb, &cd);
+  loadnumber(J, pc, 0, bb, bd);
+  loadnumber(J, pc, 1, cb, cd);
+  byte(J, 0xF2); byte(J, 0x0F); byte(J, 0x5E); byte(J, 0xC1);  /* divsd */
+  storesd(J, 0, BASE, a);
+  storeimm(J, BASE, a + TAG, LUA_TNUMFLT);
+}
+
+
+/*
+** OP_EQ, OP_LT, OP_LE over two integers or two floats, with the jump
+** that follows them: goes to the jump target if the comparison results
+** in A, otherwise skips the jump.
+*/
+static void gencompare (JitState *J, int pc, Instruction i, OpCode op) {
+  int a = GETARG_A(i);
+  int target = pc + 2 + GETARG_sBx(J->p->code[pc + 1]);
+  int bb, bd, cb, cd;
+  int flt, cc;
+  rkpos(GETARG_B(i), &bb, &bd);
+  rkpos(GETARG_C(i), &cb, &cd);
+  loadd(J, RAX, bb, bd + TAG);
+  opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TNUMINT);
+  flt = jumpfwd(J, CC_NE);
+  cmpimm(J, cb, cd + TAG, LUA_TNUMINT);
+  jumpexit(J, CC_NE, pc);
+  loadq(J, RAX, bb, bd);
+  opmem(J, 0, 1, 0x3B, RAX, cb, cd);  /* cmp rax, [c] */
+  cc = (op == OP_EQ) ? CC_E : (op == OP_LT) ? CC_L : CC_LE;
+  jumppc(J, a ? cc : negcc(cc), pc, target);
+  jumppc(J, CC_ALWAYS, pc, pc + 2);
+  patchhere(J, flt);
+  opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TNUMFLT);
+  jumpexit(J, CC_NE, pc);
+  cmpimm(J, cb, cd + TAG, LUA_TNUMFLT);
+  jumpexit(J, CC_NE, pc);
+  if (op == OP_EQ) {  /* equal iff ZF and not PF (unordered) */
+    loadsd(J, 0, bb, bd);
+    opmem(J, 0x66, 0, 0x0F2E, 0, cb, cd);  /* ucomisd xmm0, [c] */
+    if (a) {
+      jumppc(J, CC_P, pc, pc + 2);
+      jumppc(J, CC_E, pc, target);
+    }
+    else {
+      jumppc(J, CC_P, pc, target);
+      jumppc(J, CC_NE, pc, target);
+    }
+  }
+  else {  /* 'c > b' and 'c >= b' are false when unordered */
+    loadsd(J, 0, cb, cd);
+    opmem(J, 0x66, 0, 0x0F2E, 0, bb, bd);  /* ucomisd xmm0, [b] */
+    cc = (op == OP_LT) ? CC_A : CC_AE;
+    jumppc(J, a ? cc : negcc(cc), pc, target);
+  }
+  jumppc(J, CC_ALWAYS, pc, pc + 2);
+}
+
+
+/*
+** Jumps to 'iffalse' if register 'r' is false or nil, otherwise to
+** 'iftrue'.
+*/
+static void gentest (JitState *J, int pc, int r, int iftrue, int iffalse) {
+  int isnil, notbool, isfalse;
+  loadd(J, RAX, BASE, r + TAG);
+  opreg(J, 0, 0x85, RAX, RAX);  /* test eax, eax */
+  isnil = jumpfwd(J, CC_E);
+  opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TBOOLEAN);
+  notbool = jumpfwd(J, CC_NE);
+  cmpimm(J, BASE, r, 0);
+  isfalse = jumpfwd(J, CC_E);
+  patchhere(J, notbool);
+  jumppc(J, CC_ALWAYS, pc, iftrue);
+  patchhere(J, isnil);
+  patchhere(J, isfalse);
+  jumppc(J, CC_ALWAYS, pc, iffalse);
+}
+
+
+/* integer OP_FORLOOP (counts down the iterations set by OP_FORPREP) */
+static void genforloop (JitState *J, int pc, Instruction i) {
+  int a = REG(GETARG_A(i));
+  int done;
+  cmpimm(J, BASE, a + TAG, LUA_TNUMINT);
+  jumpexit(J, CC_NE, pc);
+  loadq(J, RCX, BASE, a + REG(1));  /* count */
+  opreg(J, 1, 0x85, RCX, RCX);  /* test rcx, rcx */
+  done = jumpfwd(J, CC_E);
+  opreg(J, 1, 0xFF, 1, RCX);  /* dec rcx */
+  storeq(J, RCX, BASE, a + REG(1));
+  loadq(J, RAX, BASE, a);
+  loadq(J, RCX, BASE, a + REG(2));  /* step */
+  opreg(J, 1, 0x01, RCX, RAX);  /* add rax, rcx */
+  storeq(J, RAX, BASE, a);
+  storeq(J, RAX, BASE, a + REG(3));
+  storeimm(J, BASE, a + REG(3) + TAG, LUA_TNUMINT);
+  jumppc(J, CC_ALWAYS, pc, pc + 1 + GETARG_sBx(i));
+  patchhere(J, done);
+}
+
+
+/* is the jump after instruction 'pc' a plain one (not closing upvalues)? */
+#define plainjump(p,pc)	(GETARG_A((p)->code[(pc) + 1]) == 0)
+
+
+/*
+** Generates code for instruction 'pc'; returns false if that code
+** only leaves to the interpreter.
+*/
+static int geninstruction (JitState *J, int pc) {
+  Proto *p = J->p;
+  Instruction i = p->code[pc];
+  OpCode op = genericop(GET_OPCODE(i));
+  int a = REG(GETARG_A(i));
+  SET_OPCODE(i, op);
+  switch (op) {
+    case OP_MOVE: {
+      copytv(J, BASE, a, BASE, REG(GETARG_B(i)));
+      return 1;
+    }
+    case OP_LOADK: {
+      copytv(J, BASE, a, KST, KST_(GETARG_Bx(i)));
+      return 1;
+    }
+    case OP_LOADBOOL: {
+      storeimm(J, BASE, a, GETARG_B(i));
+      storeimm(J, BASE, a + TAG, LUA_TBOOLEAN);
+      if (GETARG_C(i))  /* skip next instruction? */
+        jumppc(J, CC_ALWAYS, pc, pc + 2);
+      return 1;
+    }
+    case OP_LOADNIL: {
+      int b = GETARG_B(i);
+      do {
+        storeimm(J, BASE, a + TAG, LUA_TNIL);
+        a += TVSIZE;
+      } while (b--);
+      return 1;
+    }
+    case OP_GETUPVAL: {
+      loadq(J, RAX, CLOSURE, cast_int(offsetof(LClosure, upvals)) +
+                             cast_int(sizeof(UpVal *)) * GETARG_B(i));
+      loadq(J, RAX, RAX, cast_int(offsetof(UpVal, v)));
+      copytv(J, BASE, a, RAX, 0);
+      return 1;
+    }
+    case OP_GETTABUP: case OP_GETTABLE: {
+      gencall(J, jit_gettable, i, pc);
+      return 1;
+    }
+    case OP_SETTABUP: case OP_SETTABLE: {
+      gencall(J, jit_settable, i, pc);
+      return 1;
+    }
+    case OP_ADD: genarith(J, pc, i, 0x03, 0x0F58); return 1;
+    case OP_SUB: genarith(J, pc, i, 0x2B, 0x0F5C); return 1;
+    case OP_MUL: genarith(J, pc, i, 0x0FAF, 0x0F59); return 1;
+    case OP_MOD: genmod(J, pc, i); return 1;
+    case OP_DIV: gendiv(J, pc, i); return 1;
+    case OP_NOT: {
+      int b = REG(GETARG_B(i));
+      int nottrue, istrue1, istrue2;
+      opreg(J, 0, 0x31, RCX, RCX);  /* xor ecx, ecx */
+      loadd(J, RAX, BASE, b + TAG);
+      opreg(J, 0, 0x85, RAX, RAX);
+      istrue1 = jumpfwd(J, CC_E);  /* nil? */
+      opreg(J, 0, 0x81, 7, RAX); dword(J, LUA_TBOOLEAN);
+      nottrue = jumpfwd(J, CC_NE);
+      cmpimm(J, BASE, b, 0);
+      istrue2 = jumpfwd(J, CC_NE);
+      patchhere(J, istrue1);
+      byte(J, 0xB9); dword(J, 1);  /* mov ecx, 1 */
+      patchhere(J, nottrue);
+      patchhere(J, istrue2);
+      stored(J, RCX, BASE, a);
+      storeimm(J, BASE, a + TAG, LUA_TBOOLEAN);
+      return 1;
+    }
+    case OP_JMP: {
+      if (GETARG_A(i) != 0) break;  /* closes upvalues */
+      jumppc(J, CC_ALWAYS, pc, pc + 1 + GETARG_sBx(i));
+      return 1;
+    }
+    case OP_EQ: case OP_LT: case OP_LE: {
+      if (!plainjump(p, pc)) break;
+      gencompare(J, pc, i, op);
+      return 1;
+    }
+    case OP_TEST: {
+      int target = pc + 2 + GETARG_sBx(p->code[pc + 1]);
+      if (!plainjump(p, pc)) break;
+      if (GETARG_C(i))  /* jump if true */
+        gentest(J, pc, a, target, pc + 2);
+      else
+        gentest(J, pc, a, pc + 2, target);
+      return 1;
+    }
+    case OP_FORLOOP: {
+      genforloop(J, pc, i);
+      return 1;
+    }
+    default: break;
+  }
+  genexit(J, pc);
+  return 0;
+}
+
+
+/*
+** Generates the code of the whole function. Its first pass ('J->code'
+** is NULL) only computes the positions of instructions and exits, which
+** the second pass uses for its jumps, as all jumps have the same size.
+*/
+static void genproto (JitState *J) {
+  Proto *p = J->p;
+  int pc;
+  /* prologue: run(L, ci, target) */
+  byte(J, 0x53);  /* push rbx */
+  byte(J, 0x41); byte(J, 0x54);  /* push r12 */
+  byte(J, 0x41); byte(J, 0x55);  /* push r13 */
+  byte(J, 0x41); byte(J, 0x56);  /* push r14 */
+  byte(J, 0x41); byte(J, 0x57);  /* push r15 */
+  opreg(J, 1, 0x89, 7, LSTATE);  /* mov r12, rdi */
+  opreg(J, 1, 0x89, 6, CINFO);  /* mov r13, rsi */
+  loadq(J, BASE, CINFO, cast_int(offsetof(CallInfo, u.l.base)));
+  loadimm(J, KST, cast(size_t, p->k));
+  loadq(J, CLOSURE, CINFO, cast_int(offsetof(CallInfo, func)));
+  loadq(J, CLOSURE, CLOSURE, 0);  /* closure of 'func' */
+  byte(J, 0xFF); byte(J, 0xE2);  /* jmp rdx */
+  J->epilogue = J->pos;
+  byte(J, 0x41); byte(J, 0x5F);  /* pop r15 */
+  byte(J, 0x41); byte(J, 0x5E);  /* pop r14 */
+  byte(J, 0x41); byte(J, 0x5D);  /* pop r13 */
+  byte(J, 0x41); byte(J, 0x5C);  /* pop r12 */
+  byte(J, 0x5B);  /* pop rbx */
+  byte(J, 0xC3);  /* ret */
+  for (pc = 0; pc < p->sizecode; pc++) {
+    J->pcoff[pc] = J->pos;
+    J->entry[pc] = geninstruction(J, pc) ? J->pcoff[pc] : -1;
+  }
+  for (pc = 0; pc < p->sizecode; pc++) {  /* checks for backward jumps */
+    if (J->backoff[pc] >= 0) {
+      J->backoff[pc] = J->pos;
+      cmpimm(J, LSTATE, cast_int(offsetof(lua_State, hookmask)), 0);
+      jumpexit(J, CC_NE, pc);
+      jumpto(J, CC_ALWAYS, J->pcoff[pc]);
+    }
+  }
+  for (pc = 0; pc < p->sizecode; pc++) {  /* exits */
+    if (J->exitoff[pc] >= 0) {
+      J->exitoff[pc] = J->pos;
+      genexit(J, pc);
+    }
+  }
+}
+
+
+/*
+** Compiles function 'p', returning true if it has native code. Any
+** failure leaves 'p->jit' without code, so that it is not tried again.
+*/
+int luaJ_compile (lua_State *L, Proto *p) {
+  JitState J;
+  JitCode *j;
+  void *mem;
+  int n = p->sizecode;
+  int pc;
+  if (!G(L)->jiton) {  /* compiler turned off? */
+    p->jitcount = LUAI_JITHOT;  /* try again later */
+    return 0;
+  }
+  j = luaM_new(L, JitCode);
+  j->mcode = NULL;
+  j->entry = j->offs = NULL;
+  j->sizeoffs = 0;
+  p->jit = j;
+  j->offs = luaM_newvector(L, 4 * n, int);
+  j->sizeoffs = 4 * n;
+  J.p = p;
+  J.pcoff = j->offs;
+  J.exitoff = J.pcoff + n;
+  J.backoff = J.exitoff + n;
+  J.entry = J.backoff + n;
+  for (pc = 0; pc < n; pc++)
+    J.exitoff[pc] = J.backoff[pc] = -1;
+  J.code = NULL;
+  J.pos = 0;
+  genproto(&J);  /* first pass */
+  mem = mmap(NULL, J.pos, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return 0;
+  j->mcode = cast(unsigned char *, mem);
+  j->size = J.pos;
+  J.code = j->mcode;
+  J.pos = 0;
+  genproto(&J);  /* second pass */
+  lua_assert(cast(size_t, J.pos) == j->size);
+  if (mprotect(mem, j->size, PROT_READ | PROT_EXEC) != 0)
+    return 0;
+  j->run = cast(void (*) (lua_State *, CallInfo *, const void *), mem);
+  j->entry = J.entry;
+  return 1;
+}
+
+
+/*
+** Runs the native code of the function running in 'ci' from its saved
+** instruction, if there is code for it; when it returns, 'savedpc' has
+** the next instruction for the interpreter.
+*/
+void luaJ_execute (lua_State *L, CallInfo *ci) {
+  JitCode *j = clLvalue(ci->func)->p->jit;
+  if (j->entry != NULL && G(L)->jiton && L->hookmask == 0) {
+    int off = j->entry[ci->u.l.savedpc - clLvalue(ci->func)->p->code];
+    if (off >= 0)
+      j->run(L, ci, j->mcode + off);
+  }
+}
+
+
+void luaJ_free (lua_State *L, Proto *p) {
+  JitCode *j = p->jit;
+  if (j->mcode != NULL)
+    munmap(j->mcode, j->size);
+  luaM_freearray(L, j->offs, j->sizeoffs);
+  luaM_free(L, j);
+}
+
+
+#else				/* }{ */
+
+
+int luaJ_compile (lua_State *L, Proto *p) {
+  UNUSED(L); UNUSED(p);
+  return 0;
+}
+
+
+void luaJ_execute (lua_State *L, CallInfo *ci) {
+  UNUSED(L); UNUSED(ci);
+}
+
+
+void luaJ_free (lua_State *L, Proto *p) {
+  UNUSED(L); UNUSED(p);
+}
+
+#endif				/* } */
@@ -0,0 +1,40 @@
+/*
+** $Id: ljit.h $
+** Baseline JIT compiler for x86-64
+** See Copyright Notice in lua.h
+*/
+
+#ifndef ljit_h
+#define ljit_h
+
+#include "lobject.h"
+#include "lstate.h"
+
+
+/*
+** The compiler is used where it is supported: gcc-compatible C (not C++,
+** whose exceptions cannot cross native code) on x86-64 Linux, with the
+** default number types.
+*/
+#if !defined(LUA_USE_JIT)
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && \
+    !defined(__cplusplus) && !defined(LUA_USE_C89) && \
+    LUA_FLOAT_TYPE == LUA_FLOAT_DOUBLE && LUA_INT_TYPE == LUA_INT_LONGLONG
+#define LUA_USE_JIT	1
+#else
+#define LUA_USE_JIT	0
+#endif
+#endif
+
+
+/* number of calls plus loop iterations that make a function hot */
+#if !defined(LUAI_JITHOT)
+#define LUAI_JITHOT	64
+#endif
+
+
+LUAI_FUNC int luaJ_compile (lua_State *L, Proto *p);
+LUAI_FUNC void luaJ_execute (lua_State *L, CallInfo *ci);
+LUAI_FUNC void luaJ_free (lua_State *L, Proto *p);
+
+#endif
@@ -33,6 +33,7 @@ typedef long l_mem;
 
 /* chars used as small naturals (so that 'char' is reserved for characters) */
 typedef unsigned char lu_byte;
+typedef signed char ls_byte;
 
 
 /* maximum value for size_t */
@@ -154,6 +155,16 @@ typedef LUAI_UACINT l_uacInt;
 #endif
 
 
+/*
+** maximum number of instructions in the body of a 'local function' for
+** its calls to be expanded inline by the code generator (0 disables
+** inlining).
+*/
+#if !defined(LUAI_MAXINLINE)
+#define LUAI_MAXINLINE		8
+#endif
+
+
 
 /*
 ** type for virtual-machine instructions;
@@ -171,12 +182,30 @@ typedef unsigned long Instruction;
 ** Maximum length for short strings, that is, strings that are
 ** internalized. (Cannot be smaller than reserved words or tags for
 ** metamethods, as these strings must be internalized;
-** #("function") = 8, #("__newindex") = 10.)
+** #("function") = 8, #("__newindex") = 10. Cannot be larger than
+** 255, as 'shrlen' is a byte.) Table lookups with short keys compare
+** only pointers, but every short string created is hashed and looked
+** up in the string table; a larger value speeds up programs that index
+** tables with long names and slows down programs that build many long
+** strings that are not used as keys.
 */
 #if !defined(LUAI_MAXSHORTLEN)
 #define LUAI_MAXSHORTLEN	40
 #endif
 
+#if LUAI_MAXSHORTLEN < 10 || LUAI_MAXSHORTLEN > 255
+#error "invalid value for LUAI_MAXSHORTLEN"
+#endif
+
+
+/*
+** Minimum length for strings kept in separate buffers, which allow
+** appends in place and substrings that share bytes (see 'StrBuf').
+*/
+#if !defined(LUAI_BUFFSTRLEN)
+#define LUAI_BUFFSTRLEN		512
+#endif
+
 
 /*
 ** Initial size for the string table (must be power of 2).
@@ -189,6 +218,21 @@ typedef unsigned long Instruction;
 #endif
 
 
+/*
+** Loads of the string table, in strings per 100 slots, that make it
+** grow (when a string is added) and shrink (at the end of a collection).
+** Growing doubles its size and shrinking halves it, so the shrink load
+** is kept under half the grow load. Both can be changed with 'lua_gc'.
+*/
+#if !defined(LUAI_STRTABGROW)
+#define LUAI_STRTABGROW		100
+#endif
+
+#if !defined(LUAI_STRTABSHRINK)
+#define LUAI_STRTABSHRINK	25
+#endif
+
+
 /*
 ** Size of cache for strings in the API. 'N' is the number of
 ** sets (better be a prime) and "M" is the size of each set (M == 1
@@ -200,6 +244,17 @@ typedef unsigned long Instruction;
 #endif
 
 
+/*
+** Number of closures each prototype keeps for reuse (see 'getcached'
+** in lvm.c). Closures created alternately with different upvalues
+** (e.g., by different instances of an enclosing function) can reuse
+** each other's entries while there are enough of them.
+*/
+#if !defined(LUAI_NCLCACHE)
+#define LUAI_NCLCACHE	4
+#endif
+
+
 /* minimum size for string buffer */
 #if !defined(LUA_MINBUFFER)
 #define LUA_MINBUFFER	32
@@ -302,7 +302,7 @@ typedef TValue *StkId;  /* index to stack elements */
 */
 typedef struct TString {
   CommonHeader;
-  lu_byte extra;  /* reserved words for short strings; "has hash" for longs */
+  lu_byte extra;  /* reserved words for short strings; bits for longs */
   lu_byte shrlen;  /* length for short strings */
   unsigned int hash;
   union {
@@ -321,12 +321,49 @@ typedef union UTString {
 } UTString;
 
 
+/* bits in field 'extra' of long strings */
+#define LSTRHASHBIT	0x01	/* 'hash' is valid */
+#define LSTRBUFFBIT	0x80	/* bytes are in a buffer (see 'StrBuf') */
+
+
+/*
+** Long strings with at least LUAI_BUFFSTRLEN bytes keep their bytes in
+** a separate buffer, which can be shared: a concatenation can append
+** to the bytes in use of the buffer of its first operand, and a
+** substring can point into the bytes of its string. The bytes in use of
+** a buffer never change, so the bytes of these strings may not be
+** followed by a '\0' (see 'luaS_terminate'). The data of a buffer
+** follows the end of this structure.
+*/
+typedef struct StrBuf {
+  size_t refs;  /* number of strings using this buffer */
+  size_t size;  /* size of data */
+  size_t used;  /* bytes in use (MAX_SIZE if buffer is closed to appends) */
+} StrBuf;
+
+#define buffdata(b)	cast(char *, (b) + 1)
+
+
+/*
+** The bytes of a string kept in a buffer; follows the end of its
+** 'TString' (aligned according to 'UTString').
+*/
+typedef struct StrView {
+  StrBuf *b;
+  char *s;  /* first byte of the string */
+} StrView;
+
+#define strview(ts)	cast(StrView *, cast(char *, (ts)) + sizeof(UTString))
+
+#define isbuffstr(ts)	((ts)->extra & LSTRBUFFBIT)
+
+
 /*
-** Get the actual string (array of bytes) from a 'TString'.
-** (Access to 'extra' ensures that value is really a 'TString'.)
+** Get the actual string (array of bytes) from a 'TString'. (Reserved
+** words never have bit LSTRBUFFBIT set in 'extra'.)
 */
 #define getstr(ts)  \
-  check_exp(sizeof((ts)->extra), cast(char *, (ts)) + sizeof(UTString))
+  (isbuffstr(ts) ? strview(ts)->s : cast(char *, (ts)) + sizeof(UTString))
 
 
 /* get the actual string (array of bytes) from a Lua value */
@@ -401,6 +438,22 @@ typedef struct LocVar {
 } LocVar;
 
 
+/*
+** Associates the absolute line source for a given instruction ('pc').
+** The array 'lineinfo' gives, for each instruction, the difference in
+** lines from the previous instruction. When that difference does not
+** fit into a byte, Lua saves the absolute line for that instruction.
+** (Lua also saves the absolute line periodically, to speed up the
+** computation of a line number: we can use binary search in the
+** absolute-line array, but we must traverse the 'lineinfo' array
+** linearly to compute a line.)
+*/
+typedef struct AbsLineInfo {
+  int pc;
+  int line;
+} AbsLineInfo;
+
+
 /*
 ** Function Prototypes
 */
@@ -413,18 +466,25 @@ typedef struct Proto {
   int sizek;  /* size of 'k' */
   int sizecode;
   int sizelineinfo;
+  int sizeabslineinfo;  /* size of 'abslineinfo' */
   int sizep;  /* size of 'p' */
   int sizelocvars;
   int linedefined;  /* debug information  */
   int lastlinedefined;  /* debug information  */
   TValue *k;  /* constants used by the function */
   Instruction *code;  /* opcodes */
+  unsigned int *icache;  /* inline caches of table accesses (see lvm.c) */
   struct Proto **p;  /* functions defined inside the function */
-  int *lineinfo;  /* map from opcodes to source lines (debug information) */
+  ls_byte *lineinfo;  /* information about source lines (debug information) */
+  AbsLineInfo *abslineinfo;  /* idem */
   LocVar *locvars;  /* information about local variables (debug information) */
   Upvaldesc *upvalues;  /* upvalue information */
-  struct LClosure *cache;  /* last-created closure with this prototype */
+  struct LClosure *cache[LUAI_NCLCACHE];  /* last closures, newest first */
   TString  *source;  /* used for debug information */
+  struct Table *image;  /* strings and code of a function not loaded yet */
+  size_t imageoff;  /* position of the function inside 'image' */
+  struct JitCode *jit;  /* native code (see ljit.c) */
+  int jitcount;  /* calls and loop iterations left to compile function */
   GCObject *gclist;
 } Proto;
 
@@ -502,6 +562,12 @@ typedef struct Table {
   TValue *array;  /* array part */
   Node *node;
   Node *lastfree;  /* any free position is before this position */
+  Node *oldnode;  /* old hash part, during an incremental resize */
+  unsigned int oldleft;  /* number of nodes in 'oldnode' not moved yet */
+  unsigned int lenhint;  /* last border found by 'luaH_getn' */
+  lu_byte oldlsizenode;  /* log2 of size of 'oldnode' array */
+  lu_byte arraytype;  /* type of a packed array part (LUA_TNIL if none) */
+  unsigned int npacked;  /* number of elements in a packed array part */
   struct Table *metatable;
   GCObject *gclist;
 } Table;
@@ -530,6 +596,9 @@ LUAI_DDEC const TValue luaO_nilobject_;
 /* size of buffer for 'luaO_utf8esc' function */
 #define UTF8BUFFSZ	8
 
+/* maximum length of the conversion of a number to a string */
+#define MAXNUMBER2STR	50
+
 LUAI_FUNC int luaO_int2fb (unsigned int x);
 LUAI_FUNC int luaO_fb2int (int x);
 LUAI_FUNC int luaO_utf8esc (char *buff, unsigned long x);
@@ -538,6 +607,7 @@ LUAI_FUNC void luaO_arith (lua_State *L, int op, const TValue *p1,
                            const TValue *p2, TValue *res);
 LUAI_FUNC size_t luaO_str2num (const char *s, TValue *o);
 LUAI_FUNC int luaO_hexavalue (int c);
+LUAI_FUNC size_t luaO_tostringbuff (const TValue *obj, char *buff);
 LUAI_FUNC void luaO_tostring (lua_State *L, StkId obj);
 LUAI_FUNC const char *luaO_pushvfstring (lua_State *L, const char *fmt,
                                                        va_list argp);
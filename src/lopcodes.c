@@ -65,6 +65,15 @@ LUAI_DDEF const char *const luaP_opnames[NUM_OPCODES+1] = {
   "CLOSURE",
   "VARARG",
   "EXTRAARG",
+  "ADDINT",
+  "ADDFLT",
+  "SUBINT",
+  "SUBFLT",
+  "MULINT",
+  "MULFLT",
+  "GETTABUPCALL",
+  "GETTABUPGET",
+  "GETTABLEGET",
   NULL
 };
 
@@ -120,5 +129,57 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 1, OpArgU, OpArgN, iABx)		/* OP_CLOSURE */
  ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_VARARG */
  ,opmode(0, 0, OpArgU, OpArgU, iAx)		/* OP_EXTRAARG */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_ADDINT */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_ADDFLT */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_SUBINT */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_SUBFLT */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_MULINT */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_MULFLT */
+ ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUPCALL */
+ ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUPGET */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETTABLEGET */
 };
 
+
+LUAI_DDEF const lu_byte luaP_genericop[NUM_OPCODES] = {
+  OP_MOVE, OP_LOADK, OP_LOADKX, OP_LOADBOOL, OP_LOADNIL, OP_GETUPVAL,
+  OP_GETTABUP, OP_GETTABLE, OP_SETTABUP, OP_SETUPVAL, OP_SETTABLE,
+  OP_NEWTABLE, OP_SELF, OP_ADD, OP_SUB, OP_MUL, OP_MOD, OP_POW, OP_DIV,
+  OP_IDIV, OP_BAND, OP_BOR, OP_BXOR, OP_SHL, OP_SHR, OP_UNM, OP_BNOT,
+  OP_NOT, OP_LEN, OP_CONCAT, OP_JMP, OP_EQ, OP_LT, OP_LE, OP_TEST,
+  OP_TESTSET, OP_CALL, OP_TAILCALL, OP_RETURN, OP_FORLOOP, OP_FORPREP,
+  OP_TFORCALL, OP_TFORLOOP, OP_SETLIST, OP_CLOSURE, OP_VARARG,
+  OP_EXTRAARG,
+  OP_ADD,		/* OP_ADDINT */
+  OP_ADD,		/* OP_ADDFLT */
+  OP_SUB,		/* OP_SUBINT */
+  OP_SUB,		/* OP_SUBFLT */
+  OP_MUL,		/* OP_MULINT */
+  OP_MUL,		/* OP_MULFLT */
+  OP_GETTABUP,		/* OP_GETTABUPCALL */
+  OP_GETTABUP,		/* OP_GETTABUPGET */
+  OP_GETTABLE		/* OP_GETTABLEGET */
+};
+
+
+/*
+** Mark the first instruction of each common pair of opcodes in 'code'
+** with the superinstruction for that pair. The second instruction of a
+** pair is never marked, as a superinstruction executes it as a plain
+** instruction (see 'vmfuse' in lvm.c).
+*/
+void luaP_fuse (Instruction *code, int n) {
+  int pc;
+  for (pc = 0; pc + 1 < n; pc++) {
+    OpCode op = GET_OPCODE(code[pc]);
+    OpCode next = GET_OPCODE(code[pc + 1]);
+    if (op == OP_GETTABUP && next == OP_CALL)
+      SET_OPCODE(code[pc], OP_GETTABUPCALL);
+    else if (op == OP_GETTABUP && next == OP_GETTABLE)
+      SET_OPCODE(code[pc], OP_GETTABUPGET);
+    else if (op == OP_GETTABLE && next == OP_GETTABLE)
+      SET_OPCODE(code[pc], OP_GETTABLEGET);
+    else continue;
+    pc++;  /* skip second instruction of the pair */
+  }
+}
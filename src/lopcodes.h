@@ -219,7 +219,7 @@ OP_RETURN,/*	A B	return R(A), ... ,R(A+B-2)	(see note)	*/
 
 OP_FORLOOP,/*	A sBx	R(A)+=R(A+2);
 			if R(A) <?= R(A+1) then { pc+=sBx; R(A+3)=R(A) }*/
-OP_FORPREP,/*	A sBx	R(A)-=R(A+2); pc+=sBx				*/
+OP_FORPREP,/*	A sBx	R(A)-=R(A+2); pc+=sBx		(see note)	*/
 
 OP_TFORCALL,/*	A C	R(A+3), ... ,R(A+2+C) := R(A)(R(A+1), R(A+2));	*/
 OP_TFORLOOP,/*	A sBx	if R(A+1) ~= nil then { R(A)=R(A+1); pc += sBx }*/
@@ -230,11 +230,27 @@ OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx])			*/
 
 OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
 
-OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
+OP_EXTRAARG,/*	Ax	extra (larger) argument for previous opcode	*/
+
+/* quickened variants, never generated by the compiler (see lvm.c) */
+OP_ADDINT,/*	A B C	R(A) := RK(B) + RK(C) (integers)		*/
+OP_ADDFLT,/*	A B C	R(A) := RK(B) + RK(C) (floats)			*/
+OP_SUBINT,/*	A B C	R(A) := RK(B) - RK(C) (integers)		*/
+OP_SUBFLT,/*	A B C	R(A) := RK(B) - RK(C) (floats)			*/
+OP_MULINT,/*	A B C	R(A) := RK(B) * RK(C) (integers)		*/
+OP_MULFLT,/*	A B C	R(A) := RK(B) * RK(C) (floats)			*/
+
+/* superinstructions, set by 'luaP_fuse' on common pairs of opcodes */
+OP_GETTABUPCALL,/* A B C	OP_GETTABUP followed by OP_CALL			*/
+OP_GETTABUPGET,/* A B C	OP_GETTABUP followed by OP_GETTABLE		*/
+OP_GETTABLEGET/* A B C	OP_GETTABLE followed by OP_GETTABLE		*/
 } OpCode;
 
 
-#define NUM_OPCODES	(cast(int, OP_EXTRAARG) + 1)
+#define NUM_OPCODES	(cast(int, OP_GETTABLEGET) + 1)
+
+/* opcode that a quickened opcode or a superinstruction stands for */
+#define genericop(o)	cast(OpCode, luaP_genericop[o])
 
 
 
@@ -259,6 +275,20 @@ OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
 
   (*) All 'skips' (pc++) assume that next instruction is a jump.
 
+  (*) In an integer loop, OP_FORPREP either skips the loop (pc+=sBx+1) or
+  sets R(A+3) and falls into the first iteration; it replaces R(A+1) with
+  the number of iterations left, which OP_FORLOOP counts down instead of
+  comparing the index with the limit.
+
+  (*) Quickened opcodes replace OP_ADD, OP_SUB and OP_MUL at run time,
+  while their operands keep the same type; a dump always writes the
+  generic opcode.
+
+  (*) A superinstruction replaces only the opcode of the first instruction
+  of its pair; the second one is kept unchanged (so, jumps to it work) and
+  is executed by the superinstruction itself. Comparisons and OP_TEST(SET)
+  need no superinstructions, as they always execute their jump directly.
+
 ===========================================================================*/
 
 
@@ -289,6 +319,10 @@ LUAI_DDEC const lu_byte luaP_opmodes[NUM_OPCODES];
 
 LUAI_DDEC const char *const luaP_opnames[NUM_OPCODES+1];  /* opcode names */
 
+LUAI_DDEC const lu_byte luaP_genericop[NUM_OPCODES];
+
+LUAI_FUNC void luaP_fuse (Instruction *code, int n);
+
 
 /* number of list items to accumulate before a SETLIST instruction */
 #define LFIELDS_PER_FLUSH	50
@@ -180,7 +180,8 @@ static void new_localvar (LexState *ls, TString *name) {
                   MAXVARS, "local variables");
   luaM_growvector(ls->L, dyd->actvar.arr, dyd->actvar.n + 1,
                   dyd->actvar.size, Vardesc, MAX_INT, "local variables");
-  dyd->actvar.arr[dyd->actvar.n++].idx = cast(short, reg);
+  dyd->actvar.arr[dyd->actvar.n].idx = cast(short, reg);
+  dyd->actvar.arr[dyd->actvar.n++].pidx = -1;
 }
 
 
@@ -263,6 +264,22 @@ static void markupval (FuncState *fs, int level) {
 }
 
 
+/*
+  Local variable at given level may be changed (or may escape into a
+  closure that changes it), so calls to it cannot be expanded inline.
+*/
+static void noinline (FuncState *fs, int level) {
+  Dyndata *dyd = fs->ls->dyd;
+  Vardesc *vd = &dyd->actvar.arr[fs->firstlocal + level];
+  int i;
+  for (i = fs->firstinl; i < dyd->inl.n; i++) {
+    if (dyd->inl.arr[i].vidx == vd->idx)
+      dyd->inl.arr[i].pidx = -1;  /* cancel previous calls */
+  }
+  vd->pidx = -2;  /* no more calls */
+}
+
+
 /*
   Find variable with given name 'n'. If it is an upvalue, add this
   upvalue into all intermediate functions.
@@ -274,8 +291,10 @@ static void singlevaraux (FuncState *fs, TString *n, expdesc *var, int base) {
     int v = searchvar(fs, n);  /* look up locals at current level */
     if (v >= 0) {  /* found? */
       init_exp(var, VLOCAL, v);  /* variable is local */
-      if (!base)
+      if (!base) {
         markupval(fs, v);  /* local will be used as an upval */
+        noinline(fs, v);
+      }
     }
     else {  /* not found as local at current level; try upvalues */
       int idx = searchupvalue(fs, n);  /* try existing upvalues */
@@ -514,13 +533,15 @@ static Proto *addprototype (LexState *ls) {
 
 
 /*
-** codes instruction to create new closure in parent function.
+** codes instruction to create new closure in parent function (the
+** current one, as the new function must be closed before, so that
+** the source lines of their instructions do not interleave).
 ** The OP_CLOSURE instruction must use the last available register,
 ** so that, if it invokes the GC, the GC knows which registers
 ** are in use at that time.
 */
 static void codeclosure (LexState *ls, expdesc *v) {
-  FuncState *fs = ls->fs->prev;
+  FuncState *fs = ls->fs;
   init_exp(v, VRELOCABLE, luaK_codeABx(fs, OP_CLOSURE, 0, fs->np - 1));
   luaK_exp2nextreg(fs, v);  /* fix it at the last register */
 }
@@ -541,6 +562,8 @@ static void open_func (LexState *ls, FuncState *fs, BlockCnt *bl) {
   fs->nlocvars = 0;
   fs->nactvar = 0;
   fs->firstlocal = ls->dyd->actvar.n;
+  fs->firstinl = ls->dyd->inl.n;
+  fs->firstline = ls->dyd->lines.n;
   fs->bl = NULL;
   f = fs->f;
   f->source = ls->source;
@@ -549,16 +572,35 @@ static void open_func (LexState *ls, FuncState *fs, BlockCnt *bl) {
 }
 
 
+/*
+** Expand inline the recorded calls to local functions that were not
+** cancelled. Calls are handled from last to first, so that each
+** expansion does not move the calls still to be handled.
+*/
+static void inlinecalls (FuncState *fs) {
+  Dyndata *dyd = fs->ls->dyd;
+  int i;
+  for (i = dyd->inl.n - 1; i >= fs->firstinl; i--) {
+    Inlinedesc *d = &dyd->inl.arr[i];
+    if (d->pidx >= 0)
+      luaK_inline(fs, d->pc, fs->f->p[d->pidx]);
+  }
+  dyd->inl.n = fs->firstinl;  /* remove calls from the list */
+}
+
+
 static void close_func (LexState *ls) {
   lua_State *L = ls->L;
   FuncState *fs = ls->fs;
   Proto *f = fs->f;
   luaK_ret(fs, 0, 0);  /* final return */
   leaveblock(fs);
+  inlinecalls(fs);
+  luaK_finish(fs);
   luaM_reallocvector(L, f->code, f->sizecode, fs->pc, Instruction);
   f->sizecode = fs->pc;
-  luaM_reallocvector(L, f->lineinfo, f->sizelineinfo, fs->pc, int);
-  f->sizelineinfo = fs->pc;
+  luaP_fuse(f->code, f->sizecode);
+  luaF_newicache(L, f);
   luaM_reallocvector(L, f->k, f->sizek, fs->nk, TValue);
   f->sizek = fs->nk;
   luaM_reallocvector(L, f->p, f->sizep, fs->np, Proto *);
@@ -796,8 +838,8 @@ static void body (LexState *ls, expdesc *e, int ismethod, int line) {
   statlist(ls);
   new_fs.f->lastlinedefined = ls->linenumber;
   check_match(ls, TK_END, TK_FUNCTION, line);
-  codeclosure(ls, e);
   close_func(ls);
+  codeclosure(ls, e);
 }
 
 
@@ -814,6 +856,20 @@ static int explist (LexState *ls, expdesc *v) {
 }
 
 
+/*
+** Record call at 'pc' to local variable 'vidx' holding the function
+** 'pidx', to be expanded inline when the function is closed.
+*/
+static void addinline (LexState *ls, int pc, int vidx, int pidx) {
+  Dyndata *dyd = ls->dyd;
+  luaM_growvector(ls->L, dyd->inl.arr, dyd->inl.n, dyd->inl.size,
+                  Inlinedesc, MAX_INT, "inline calls");
+  dyd->inl.arr[dyd->inl.n].pc = pc;
+  dyd->inl.arr[dyd->inl.n].vidx = cast(short, vidx);
+  dyd->inl.arr[dyd->inl.n++].pidx = cast(short, pidx);
+}
+
+
 static void funcargs (LexState *ls, expdesc *f, int line) {
   FuncState *fs = ls->fs;
   expdesc args;
@@ -918,8 +974,16 @@ static void suffixedexp (LexState *ls, expdesc *v) {
         break;
       }
       case '(': case TK_STRING: case '{': {  /* funcargs */
+        int vidx = -1, pidx = -1;
+        if (v->k == VLOCAL) {  /* calling a local variable? */
+          Vardesc *vd = &ls->dyd->actvar.arr[fs->firstlocal + v->u.info];
+          vidx = vd->idx;
+          pidx = vd->pidx;
+        }
         luaK_exp2nextreg(fs, v);
         funcargs(ls, v, line);
+        if (pidx >= 0)  /* a 'local function'? */
+          addinline(ls, v->u.info, vidx, pidx);
         break;
       }
       default: return;
@@ -1147,6 +1211,8 @@ static void check_conflict (LexState *ls, struct LHS_assign *lh, expdesc *v) {
 static void assignment (LexState *ls, struct LHS_assign *lh, int nvars) {
   expdesc e;
   check_condition(ls, vkisvar(lh->v.k), "syntax error");
+  if (lh->v.k == VLOCAL)
+    noinline(ls->fs, lh->v.u.info);
   if (testnext(ls, ',')) {  /* assignment -> ',' suffixedexp assignment */
     struct LHS_assign nv;
     nv.prev = lh;
@@ -1436,6 +1502,66 @@ static void localfunc (LexState *ls) {
   body(ls, &b, 0, ls->linenumber);  /* function created in next register */
   /* debug information will only see the variable after this point! */
   getlocvar(fs, b.u.info)->startpc = fs->pc;
+  if (LUAI_MAXINLINE > 0) {
+    Vardesc *vd = &ls->dyd->actvar.arr[fs->firstlocal + b.u.info];
+    if (vd->pidx == -1 && fs->np <= SHRT_MAX)  /* not recursive? */
+      vd->pidx = cast(short, fs->np - 1);  /* calls may be expanded inline */
+  }
+}
+
+
+/*
+** check whether the variable at level 'v' has the same name as one of
+** the variables from level 'first' up
+*/
+static int isshadowed (FuncState *fs, int v, int first) {
+  TString *name = getlocvar(fs, v)->varname;
+  int i;
+  for (i = first; i < fs->nactvar; i++) {
+    if (eqstr(name, getlocvar(fs, i)->varname))
+      return 1;
+  }
+  return 0;
+}
+
+
+/*
+** Variables of the current block right below the 'nvars' new ones that
+** are shadowed by them are dead, as they cannot be named anymore (and
+** their upvalues, if any, are closed here). Remove them, moving the new
+** variables down into their registers, so that repeated declarations
+** (such as temporaries from expanded macros) do not use up registers.
+** Labels and pending gotos of the block record the variables active at
+** their points, so a block with any of them is left alone.
+*/
+static void reusevars (LexState *ls, int nvars) {
+  FuncState *fs = ls->fs;
+  Dyndata *dyd = ls->dyd;
+  int first = fs->nactvar - nvars;  /* level of first new variable */
+  int level = first;  /* level of first dead variable */
+  int i;
+  if (dyd->label.n > fs->bl->firstlabel || dyd->gt.n > fs->bl->firstgoto)
+    return;  /* reuse could change the scopes seen by 'goto' */
+  while (level > fs->bl->nactvar && isshadowed(fs, level - 1, first))
+    level--;
+  if (level == first)
+    return;  /* no dead variables */
+  for (i = level; i < first; i++)
+    getlocvar(fs, i)->endpc = fs->pc;
+  if (fs->bl->upval) {  /* dead variables may have upvalues? */
+    int j = luaK_jump(fs);
+    luaK_patchclose(fs, j, level);
+    luaK_patchtohere(fs, j);
+  }
+  for (i = 0; i < nvars; i++)
+    luaK_codeABC(fs, OP_MOVE, level + i, first + i, 0);
+  memmove(&dyd->actvar.arr[fs->firstlocal + level],
+          &dyd->actvar.arr[fs->firstlocal + first], nvars * sizeof(Vardesc));
+  dyd->actvar.n -= first - level;
+  fs->nactvar = cast_byte(level + nvars);
+  fs->freereg = fs->nactvar;
+  for (i = level; i < fs->nactvar; i++)
+    getlocvar(fs, i)->startpc = fs->pc;
 }
 
 
@@ -1456,6 +1582,7 @@ static void localstat (LexState *ls) {
   }
   adjust_assign(ls, nvars, nexps, &e);
   adjustlocalvars(ls, nvars);
+  reusevars(ls, nvars);
 }
 
 
@@ -1479,6 +1606,8 @@ static void funcstat (LexState *ls, int line) {
   expdesc v, b;
   luaX_next(ls);  /* skip FUNCTION */
   ismethod = funcname(ls, &v);
+  if (v.k == VLOCAL)
+    noinline(ls->fs, v.u.info);
   body(ls, &b, ismethod, line);
   luaK_storevar(ls->fs, &v, &b);
   luaK_fixline(ls->fs, line);  /* definition "happens" in the first line */
@@ -1643,12 +1772,13 @@ LClosure *luaY_parser (lua_State *L, ZIO *z, Mbuffer *buff,
   lua_assert(iswhite(funcstate.f));  /* do not need barrier here */
   lexstate.buff = buff;
   lexstate.dyd = dyd;
-  dyd->actvar.n = dyd->gt.n = dyd->label.n = 0;
+  dyd->actvar.n = dyd->gt.n = dyd->label.n = dyd->inl.n = dyd->lines.n = 0;
   luaX_setinput(L, &lexstate, z, funcstate.f->source, firstchar);
   mainfunc(&lexstate, &funcstate);
   lua_assert(!funcstate.prev && funcstate.nups == 1 && !lexstate.fs);
   /* all scopes should be correctly finished */
   lua_assert(dyd->actvar.n == 0 && dyd->gt.n == 0 && dyd->label.n == 0);
+  lua_assert(dyd->inl.n == 0 && dyd->lines.n == 0);
   L->top--;  /* remove scanner's table */
   return cl;  /* closure is on the stack, too */
 }
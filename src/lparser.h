@@ -71,9 +71,18 @@ typedef struct expdesc {
 /* description of active local variable */
 typedef struct Vardesc {
   short idx;  /* variable index in stack */
+  short pidx;  /* prototype of a 'local function' (index in 'f->p'), or -1 */
 } Vardesc;
 
 
+/* description of a call that may be expanded inline */
+typedef struct Inlinedesc {
+  int pc;  /* position of the OP_CALL instruction */
+  short vidx;  /* called variable (index in 'f->locvars') */
+  short pidx;  /* called prototype (index in 'f->p'), or -1 if cancelled */
+} Inlinedesc;
+
+
 /* description of pending goto statements and label statements */
 typedef struct Labeldesc {
   TString *name;  /* label identifier */
@@ -100,6 +109,16 @@ typedef struct Dyndata {
   } actvar;
   Labellist gt;  /* list of pending gotos */
   Labellist label;   /* list of active labels */
+  struct {  /* source lines of the instructions being generated */
+    int *arr;
+    int n;
+    int size;
+  } lines;
+  struct {  /* list of calls to local functions */
+    Inlinedesc *arr;
+    int n;
+    int size;
+  } inl;
 } Dyndata;
 
 
@@ -119,6 +138,8 @@ typedef struct FuncState {
   int nk;  /* number of elements in 'k' */
   int np;  /* number of elements in 'p' */
   int firstlocal;  /* index of first local var (in Dyndata array) */
+  int firstinl;  /* index of first inline call (in Dyndata array) */
+  int firstline;  /* index of first source line (in Dyndata array) */
   short nlocvars;  /* number of elements in 'f->locvars' */
   lu_byte nactvar;  /* number of active local variables */
   lu_byte nups;  /* number of upvalues */
@@ -0,0 +1,293 @@
+/*
+** $Id: lproflib.c $
+** Sampling profiler library
+** See Copyright Notice in lua.h
+*/
+
+#define lproflib_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/*
+** The profiler takes samples of the stack of the running thread at
+** regular intervals of CPU time. A timer signal only calls 'lua_sample',
+** which makes the VM call 'sampler' before its next instruction (so,
+** time spent inside C functions is counted when they return to Lua).
+** Each sample is a list of the active functions, from the outermost to
+** the innermost one, separated by ';'. The result counts how many
+** samples had each stack, one stack per line ("folded stacks"), which
+** is the input format of flame-graph tools.
+*/
+
+
+/* maximum number of stack levels in a sample */
+#if !defined(LUAI_PROFDEPTH)
+#define LUAI_PROFDEPTH	100
+#endif
+
+
+/* default interval between samples, in milliseconds */
+#if !defined(LUAI_PROFINTERVAL)
+#define LUAI_PROFINTERVAL	1
+#endif
+
+
+/* keys in the registry for the table of counts and the output file */
+static const char COUNTS = 'c';
+static const char OUTFILE = 'f';
+
+
+/* state being profiled (there is only one timer per process) */
+static lua_State *volatile profiled = NULL;
+
+
+static void onsignal (int i) {
+  lua_State *L = profiled;
+  (void)i;  /* to avoid warnings */
+  if (L != NULL)
+    lua_sample(L);
+}
+
+
+/*
+** {======================================================
+** Timer
+** =======================================================
+*/
+
+#if !defined(l_starttimer)	/* { */
+
+#if defined(LUA_USE_POSIX)	/* { */
+
+#include <signal.h>
+#include <sys/time.h>
+
+static struct sigaction oldaction;
+
+static int l_starttimer (lua_Number ms) {
+  struct sigaction action;
+  struct itimerval t;
+  long us = (long)(ms * 1000);
+  action.sa_handler = onsignal;
+  action.sa_flags = SA_RESTART;  /* do not interrupt the program */
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &oldaction) != 0)
+    return 0;
+  t.it_interval.tv_sec = us / 1000000;
+  t.it_interval.tv_usec = (us > 0) ? us % 1000000 : 1;
+  t.it_value = t.it_interval;
+  if (setitimer(ITIMER_PROF, &t, NULL) != 0) {
+    sigaction(SIGPROF, &oldaction, NULL);
+    return 0;
+  }
+  return 1;
+}
+
+static void l_stoptimer (void) {
+  struct itimerval t;
+  memset(&t, 0, sizeof(t));
+  setitimer(ITIMER_PROF, &t, NULL);
+  sigaction(SIGPROF, &oldaction, NULL);
+}
+
+#else				/* }{ */
+
+/* ISO C has no timers; profiler cannot be started */
+#define l_starttimer(ms)	((void)(ms), 0)
+#define l_stoptimer()		((void)0)
+
+#endif				/* } */
+
+#endif				/* } */
+
+/* }====================================================== */
+
+
+/*
+** Push the name of an active function: its name (if known) with its
+** place of definition. (';' separates functions in a sample, so it
+** cannot appear in names.)
+*/
+static void pushframe (lua_State *L, lua_Debug *ar) {
+  const char *name = (ar->name != NULL) ? ar->name : "?";
+  const char *s;
+  if (*ar->what == 'C')
+    s = lua_pushfstring(L, "%s [C]", name);
+  else if (*ar->what == 'm')
+    s = lua_pushfstring(L, "main chunk (%s)", ar->short_src);
+  else
+    s = lua_pushfstring(L, "%s (%s:%d)", name, ar->short_src,
+                                         ar->linedefined);
+  if (strchr(s, ';') != NULL) {
+    luaL_gsub(L, s, ";", ",");
+    lua_remove(L, -2);  /* remove original name */
+  }
+}
+
+
+/*
+** Take a sample: build the stack of 'L' and count it.
+*/
+static void sampler (lua_State *L, lua_Debug *ar) {
+  int top = lua_gettop(L);
+  int n, i;
+  lua_Debug d;
+  luaL_Buffer b;
+  (void)ar;  /* not used */
+  if (!lua_checkstack(L, LUAI_PROFDEPTH + LUA_MINSTACK))
+    return;  /* no space for a sample; skip it */
+  for (n = 0; n < LUAI_PROFDEPTH && lua_getstack(L, n, &d); n++) {
+    lua_getinfo(L, "Sn", &d);
+    pushframe(L, &d);  /* innermost function is pushed first */
+  }
+  luaL_buffinit(L, &b);
+  for (i = n; i > 0; i--) {  /* add functions from outermost one */
+    lua_pushvalue(L, top + i);
+    luaL_addvalue(&b);
+    if (i > 1) luaL_addchar(&b, ';');
+  }
+  luaL_pushresult(&b);
+  if (lua_rawgetp(L, LUA_REGISTRYINDEX, &COUNTS) == LUA_TTABLE) {
+    lua_pushvalue(L, -2);  /* stack */
+    lua_pushvalue(L, -1);
+    lua_rawget(L, -3);  /* current count (nil if none) */
+    lua_pushinteger(L, lua_tointeger(L, -1) + 1);
+    lua_remove(L, -2);  /* remove current count */
+    lua_rawset(L, -3);  /* counts[stack] = count + 1 */
+  }
+  lua_settop(L, top);
+}
+
+
+/*
+** Check whether the profiler is running in the state of 'L'
+*/
+static int isrunning (lua_State *L) {
+  lua_State *L1;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+  L1 = lua_tothread(L, -1);
+  lua_pop(L, 1);
+  return (profiled != NULL && profiled == L1);
+}
+
+
+/*
+** Stop the profiler running in 'L' (if any) and push its result. If the
+** profiler was started with an output file, also write the result to
+** that file; returns false if that fails.
+*/
+static int stopprofiler (lua_State *L) {
+  luaL_Buffer b;
+  int n = 0;
+  int i, t;
+  int ok = 1;
+  if (!isrunning(L)) {
+    lua_pushliteral(L, "");
+    return 1;
+  }
+  l_stoptimer();
+  profiled = NULL;
+  lua_setsampler(L, NULL);
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &COUNTS);
+  t = lua_gettop(L);
+  lua_newtable(L);  /* lines of the result */
+  lua_pushnil(L);  /* first key */
+  while (lua_next(L, t) != 0) {  /* for each stack */
+    lua_pushfstring(L, "%s %I\n", lua_tostring(L, -2),
+                                  lua_tointeger(L, -1));
+    lua_rawseti(L, t + 1, ++n);
+    lua_pop(L, 1);  /* remove count */
+  }
+  luaL_buffinit(L, &b);
+  for (i = 1; i <= n; i++) {
+    lua_rawgeti(L, t + 1, i);
+    luaL_addvalue(&b);
+  }
+  luaL_pushresult(&b);
+  lua_replace(L, t);  /* result replaces table of counts */
+  lua_settop(L, t);
+  lua_pushnil(L);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &COUNTS);
+  if (lua_rawgetp(L, LUA_REGISTRYINDEX, &OUTFILE) == LUA_TSTRING) {
+    FILE *f = fopen(lua_tostring(L, -1), "w");
+    size_t len;
+    const char *s = lua_tolstring(L, -2, &len);
+    ok = (f != NULL && fwrite(s, 1, len, f) == len);
+    if (f != NULL && fclose(f) != 0) ok = 0;
+  }
+  lua_pop(L, 1);
+  lua_pushnil(L);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &OUTFILE);
+  return ok;
+}
+
+
+static int prof_start (lua_State *L) {
+  lua_Number ms = luaL_optnumber(L, 1, LUAI_PROFINTERVAL);
+  const char *fname = luaL_optstring(L, 2, NULL);
+  luaL_argcheck(L, ms > 0, 1, "interval must be positive");
+  if (profiled != NULL)
+    return luaL_error(L, isrunning(L) ? "profiler already running"
+                                      : "profiler running in another state");
+  lua_newtable(L);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &COUNTS);
+  if (fname != NULL) {
+    lua_pushstring(L, fname);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &OUTFILE);
+  }
+  lua_setsampler(L, sampler);
+  lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+  profiled = lua_tothread(L, -1);  /* (a main thread is never collected) */
+  if (!l_starttimer(ms)) {
+    profiled = NULL;
+    lua_setsampler(L, NULL);
+    return luaL_error(L, "cannot start profiler timer");
+  }
+  return 0;
+}
+
+
+static int prof_stop (lua_State *L) {
+  if (!stopprofiler(L))
+    return luaL_error(L, "cannot write profile");
+  return 1;
+}
+
+
+/*
+** Finalizer of the library: stops a profiler still running when the
+** state is closed, writing its output file.
+*/
+static int prof_gc (lua_State *L) {
+  stopprofiler(L);
+  return 0;
+}
+
+
+static const luaL_Reg prof_funcs[] = {
+  {"start", prof_start},
+  {"stop", prof_stop},
+  {NULL, NULL}
+};
+
+
+LUAMOD_API int luaopen_profiler (lua_State *L) {
+  luaL_newlib(L, prof_funcs);
+  lua_createtable(L, 0, 1);  /* metatable to stop profiler when closing */
+  lua_pushcfunction(L, prof_gc);
+  lua_setfield(L, -2, "__gc");
+  lua_setmetatable(L, -2);
+  return 1;
+}
+
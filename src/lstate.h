@@ -59,6 +59,10 @@ typedef struct stringtable {
   TString **hash;
   int nuse;  /* number of elements */
   int size;
+  int grow;  /* load (in percentage) that makes the table grow */
+  int shrink;  /* load (in percentage) that makes the table shrink */
+  lu_mem hits;  /* lookups that found an existing string */
+  lu_mem misses;  /* lookups that created a new string */
 } stringtable;
 
 
@@ -130,6 +134,7 @@ typedef struct global_State {
   lu_byte gcstate;  /* state of garbage collector */
   lu_byte gckind;  /* kind of GC running */
   lu_byte gcrunning;  /* true if GC is running */
+  lu_byte jiton;  /* true if JIT compiler is on */
   GCObject *allgc;  /* list of all collectable objects */
   GCObject **sweepgc;  /* current position of sweep in list */
   GCObject *finobj;  /* list of collectable objects with finalizers */
@@ -146,6 +151,8 @@ typedef struct global_State {
   int gcstepmul;  /* GC 'granularity' */
   lua_CFunction panic;  /* to be called in unprotected errors */
   struct lua_State *mainthread;
+  struct lua_State *volatile running;  /* thread running Lua code */
+  volatile lua_Hook sampler;  /* profiler sampler (see 'lua_sample') */
   const lua_Number *version;  /* pointer to version number */
   TString *memerrmsg;  /* memory-error message */
   TString *tmname[TM_N];  /* array with tag-method names */
@@ -25,15 +25,6 @@
 #define MEMERRMSG       "not enough memory"
 
 
-/*
-** Lua will use at most ~(2^LUAI_HASHLIMIT) bytes from a string to
-** compute its hash
-*/
-#if !defined(LUAI_HASHLIMIT)
-#define LUAI_HASHLIMIT		5
-#endif
-
-
 /*
 ** equality for long strings
 */
@@ -42,24 +33,88 @@ int luaS_eqlngstr (TString *a, TString *b) {
   lua_assert(a->tt == LUA_TLNGSTR && b->tt == LUA_TLNGSTR);
   return (a == b) ||  /* same instance or... */
     ((len == b->u.lnglen) &&  /* equal length and ... */
-     (memcmp(getstr(a), getstr(b), len) == 0));  /* equal contents */
+     (getstr(a) == getstr(b) ||  /* same bytes or... */
+      memcmp(getstr(a), getstr(b), len) == 0));  /* equal contents */
 }
 
 
+/*
+** {======================================================
+** Hash function
+** =======================================================
+*/
+
+/*
+** Strings are hashed with HalfSipHash-1-3 (by Aumasson and Bernstein),
+** keyed by the seed of the state. It hashes all bytes of a string,
+** four bytes per round, and, as a keyed hash, makes it hard to build
+** sets of strings that collide in a given state.
+*/
+
+/* type for 32-bit words (with at least 32 bits) */
+#if LUAI_BITSINT >= 32
+typedef unsigned int hword;
+#else
+typedef unsigned long hword;
+#endif
+
+#define MASK32		cast(hword, 0xffffffffUL)
+
+#define rotl32(x,n)	((((x) << (n)) | ((x) >> (32 - (n)))) & MASK32)
+
+/* read 4 bytes as a little-endian word */
+#define getword(p)  \
+	(cast(hword, cast_byte((p)[0])) | (cast(hword, cast_byte((p)[1])) << 8) | \
+	 (cast(hword, cast_byte((p)[2])) << 16) | \
+	 (cast(hword, cast_byte((p)[3])) << 24))
+
+#define sipround(v0,v1,v2,v3) { \
+  v0 = (v0 + v1) & MASK32; v1 = rotl32(v1, 5); v1 ^= v0; \
+  v0 = rotl32(v0, 16); \
+  v2 = (v2 + v3) & MASK32; v3 = rotl32(v3, 8); v3 ^= v2; \
+  v0 = (v0 + v3) & MASK32; v3 = rotl32(v3, 7); v3 ^= v0; \
+  v2 = (v2 + v1) & MASK32; v1 = rotl32(v1, 13); v1 ^= v2; \
+  v2 = rotl32(v2, 16); }
+
+
 unsigned int luaS_hash (const char *str, size_t l, unsigned int seed) {
-  unsigned int h = seed ^ cast(unsigned int, l);
-  size_t step = (l >> LUAI_HASHLIMIT) + 1;
-  for (; l >= step; l -= step)
-    h ^= ((h<<5) + (h>>2) + cast_byte(str[l - 1]));
-  return h;
+  hword k0 = seed & MASK32;
+  hword k1 = ~k0 & MASK32;  /* (key has only the bits of the seed) */
+  hword v0 = k0;
+  hword v1 = k1;
+  hword v2 = k0 ^ 0x6c796765;
+  hword v3 = k1 ^ 0x74656462;
+  hword b = (cast(hword, l) << 24) & MASK32;
+  const char *end = str + (l & ~cast(size_t, 3));
+  for (; str < end; str += 4) {  /* hash each complete word */
+    hword m = getword(str);
+    v3 ^= m;
+    sipround(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+  switch (l & 3) {  /* add remaining bytes to last word */
+    case 3: b |= cast(hword, cast_byte(str[2])) << 16;  /* FALLTHROUGH */
+    case 2: b |= cast(hword, cast_byte(str[1])) << 8;  /* FALLTHROUGH */
+    case 1: b |= cast(hword, cast_byte(str[0]));
+  }
+  v3 ^= b;
+  sipround(v0, v1, v2, v3);
+  v0 ^= b;
+  v2 ^= 0xff;  /* finalization */
+  sipround(v0, v1, v2, v3);
+  sipround(v0, v1, v2, v3);
+  sipround(v0, v1, v2, v3);
+  return cast(unsigned int, v1 ^ v3);
 }
 
+/* }====================================================== */
+
 
 unsigned int luaS_hashlongstr (TString *ts) {
   lua_assert(ts->tt == LUA_TLNGSTR);
-  if (ts->extra == 0) {  /* no hash? */
+  if (!(ts->extra & LSTRHASHBIT)) {  /* no hash? */
     ts->hash = luaS_hash(getstr(ts), ts->u.lnglen, ts->hash);
-    ts->extra = 1;  /* now it has its hash */
+    ts->extra |= LSTRHASHBIT;  /* now it has its hash */
   }
   return ts->hash;
 }
@@ -144,8 +199,177 @@ static TString *createstrobj (lua_State *L, size_t l, int tag, unsigned int h) {
 }
 
 
+/*
+** {======================================================
+** Buffered strings
+** =======================================================
+*/
+
+/* value of 'used' for buffers closed to appends */
+#define CLOSED		MAX_SIZE
+
+
+/*
+** Creates a buffer with room for 'size' bytes plus a '\0', with the
+** first 'used' of them in use (or closed, if 'used' is CLOSED).
+*/
+static StrBuf *newbuff (lua_State *L, size_t size, size_t used) {
+  StrBuf *b;
+  if (size >= MAX_SIZE - sizeof(StrBuf))
+    luaM_toobig(L);
+  b = cast(StrBuf *, luaM_malloc(L, sizeof(StrBuf) + size + 1));
+  b->refs = 0;
+  b->size = size + 1;
+  b->used = used;
+  return b;
+}
+
+
+static void releasebuff (lua_State *L, StrBuf *b) {
+  if (b != NULL && --b->refs == 0)  /* last string using it? */
+    luaM_freemem(L, b, sizeof(StrBuf) + b->size);
+}
+
+
+/* makes 'ts' use the bytes starting at 's' in buffer 'b' */
+static void setview (TString *ts, StrBuf *b, char *s) {
+  StrView *v = strview(ts);
+  b->refs++;
+  v->b = b;
+  v->s = s;
+}
+
+
+/*
+** Creates a buffered string with length 'l', still without a buffer.
+** (Any error between this call and 'setview' leaves a valid string for
+** the collector.)
+*/
+static TString *newview (lua_State *L, size_t l) {
+  GCObject *o = luaC_newobj(L, LUA_TLNGSTR, sizebuffstr);
+  TString *ts = gco2ts(o);
+  ts->hash = G(L)->seed;
+  ts->extra = LSTRBUFFBIT;
+  ts->u.lnglen = l;
+  strview(ts)->b = NULL;
+  strview(ts)->s = NULL;
+  return ts;
+}
+
+
+/*
+** Creates a buffered string with length 'l' in a new buffer with room
+** for 'size' bytes. The buffer is closed to appends unless 'open' is
+** true.
+*/
+static TString *newbuffstr (lua_State *L, size_t l, size_t size, int open) {
+  TString *ts = newview(L, l);
+  StrBuf *b = newbuff(L, size, open ? l : CLOSED);
+  lua_assert(l <= size);
+  setview(ts, b, buffdata(b));
+  buffdata(b)[l] = '\0';  /* ending 0 */
+  return ts;
+}
+
+
+void luaS_freelngstr (lua_State *L, TString *ts) {
+  if (isbuffstr(ts)) {
+    releasebuff(L, strview(ts)->b);
+    luaM_freemem(L, ts, sizebuffstr);
+  }
+  else
+    luaM_freemem(L, ts, sizelstring(ts->u.lnglen));
+}
+
+
+/*
+** Creates a long string with length 'l' for the result of a concatenation
+** whose first operand is 'first'. If 'first' ends the bytes in use of
+** its buffer and there is room after them, the result shares those
+** bytes: it starts at the same address as 'first', so the caller has to
+** copy only the other operands. Otherwise, if 'first' was itself the
+** result of a concatenation, the new buffer gets room for appends that
+** double its size, so that repeated appends to a string take linear
+** time.
+*/
+TString *luaS_newconcat (lua_State *L, TString *first, size_t l) {
+  if (l < LUAI_BUFFSTRLEN)
+    return luaS_createlngstrobj(L, l);
+  if (isbuffstr(first)) {  /* (reserved words never have this bit) */
+    StrView *v = strview(first);
+    StrBuf *b = v->b;
+    size_t end = (v->s - buffdata(b)) + first->u.lnglen;
+    lua_assert(first->tt == LUA_TLNGSTR && first->u.lnglen <= l);
+    if (end == b->used && l - first->u.lnglen < b->size - end) {
+      TString *ts = newview(L, l);  /* append in place */
+      setview(ts, b, v->s);
+      b->used = end + (l - first->u.lnglen);
+      v->s[l] = '\0';  /* ending 0 */
+      return ts;
+    }
+    else if (b->used != CLOSED)  /* 'first' from a concatenation? */
+      return newbuffstr(L, l, (l <= MAX_SIZE / 4) ? 2 * l : l, 1);
+  }
+  return newbuffstr(L, l, l, 1);
+}
+
+
+/*
+** Creates the substring with 'l' bytes of 'ts' starting at its byte 'i'
+** (counting from 0). Large substrings of buffered strings share their
+** bytes, if they keep at least a quarter of the buffer in use.
+*/
+TString *luaS_sub (lua_State *L, TString *ts, size_t i, size_t l) {
+  lua_assert(i <= tsslen(ts) && l <= tsslen(ts) - i);
+  if (i == 0 && l == tsslen(ts))
+    return ts;
+  else if (l >= LUAI_BUFFSTRLEN && isbuffstr(ts) &&
+           l >= strview(ts)->b->size / 4) {
+    TString *sub = newview(L, l);
+    setview(sub, strview(ts)->b, strview(ts)->s + i);
+    return sub;
+  }
+  else
+    return luaS_newlstr(L, getstr(ts) + i, l);
+}
+
+
+/*
+** Makes sure that the bytes of 'ts' are followed by a '\0' that will
+** not change, as C code needs (the bytes of buffered strings may be
+** followed by other bytes or by appends), and returns its bytes. The
+** bytes in use of a buffer do not change, so either the string ends
+** them and the buffer is closed to further appends, or its bytes are
+** copied to a new buffer when not followed by a '\0'.
+*/
+const char *luaS_terminate (lua_State *L, TString *ts) {
+  if (isbuffstr(ts)) {
+    StrView *v = strview(ts);
+    StrBuf *b = v->b;
+    size_t l = ts->u.lnglen;
+    size_t end = (v->s - buffdata(b)) + l;
+    lua_assert(ts->tt == LUA_TLNGSTR && end <= b->used);
+    if (end == b->used)  /* string ends the bytes in use? */
+      b->used = CLOSED;  /* keep its ending 0 */
+    else if (v->s[l] != '\0') {  /* must copy it */
+      StrBuf *nb = newbuff(L, l, CLOSED);
+      memcpy(buffdata(nb), v->s, l * sizeof(char));
+      buffdata(nb)[l] = '\0';
+      releasebuff(L, b);
+      setview(ts, nb, buffdata(nb));
+    }
+  }
+  return getstr(ts);
+}
+
+/* }====================================================== */
+
+
 TString *luaS_createlngstrobj (lua_State *L, size_t l) {
-  TString *ts = createstrobj(L, l, LUA_TLNGSTR, G(L)->seed);
+  TString *ts;
+  if (l >= LUAI_BUFFSTRLEN)
+    return newbuffstr(L, l, l, 0);
+  ts = createstrobj(L, l, LUA_TLNGSTR, G(L)->seed);
   ts->u.lnglen = l;
   return ts;
 }
@@ -176,10 +400,14 @@ static TString *internshrstr (lua_State *L, const char *str, size_t l) {
       /* found! */
       if (isdead(g, ts))  /* dead (but not collected yet)? */
         changewhite(ts);  /* resurrect it */
+      g->strt.hits++;
       return ts;
     }
   }
-  if (g->strt.nuse >= g->strt.size && g->strt.size <= MAX_INT/2) {
+  g->strt.misses++;
+  if (cast(lu_mem, g->strt.nuse) * 100 >=
+        cast(lu_mem, g->strt.size) * g->strt.grow &&
+      g->strt.size <= MAX_INT/2) {
     luaS_resize(L, g->strt.size * 2);
     list = &g->strt.hash[lmod(h, g->strt.size)];  /* recompute with new size */
   }
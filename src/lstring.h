@@ -14,6 +14,9 @@
 
 #define sizelstring(l)  (sizeof(union UTString) + ((l) + 1) * sizeof(char))
 
+/* size of a long string kept in a buffer (without the buffer) */
+#define sizebuffstr	(sizeof(union UTString) + sizeof(StrView))
+
 #define sizeludata(l)	(sizeof(union UUdata) + (l))
 #define sizeudata(u)	sizeludata((u)->len)
 
@@ -44,6 +47,10 @@ LUAI_FUNC Udata *luaS_newudata (lua_State *L, size_t s);
 LUAI_FUNC TString *luaS_newlstr (lua_State *L, const char *str, size_t l);
 LUAI_FUNC TString *luaS_new (lua_State *L, const char *str);
 LUAI_FUNC TString *luaS_createlngstrobj (lua_State *L, size_t l);
+LUAI_FUNC TString *luaS_newconcat (lua_State *L, TString *first, size_t l);
+LUAI_FUNC TString *luaS_sub (lua_State *L, TString *ts, size_t i, size_t l);
+LUAI_FUNC const char *luaS_terminate (lua_State *L, TString *ts);
+LUAI_FUNC void luaS_freelngstr (lua_State *L, TString *ts);
 
 
 #endif
@@ -69,13 +69,16 @@ static lua_Integer posrelat (lua_Integer pos, size_t len) {
 
 static int str_sub (lua_State *L) {
   size_t l;
-  const char *s = luaL_checklstring(L, 1, &l);
-  lua_Integer start = posrelat(luaL_checkinteger(L, 2), l);
-  lua_Integer end = posrelat(luaL_optinteger(L, 3, -1), l);
+  lua_Integer start, end;
+  if (lua_type(L, 1) != LUA_TSTRING)  /* (no need to get its bytes) */
+    luaL_checkstring(L, 1);  /* converts a number to a string */
+  l = lua_rawlen(L, 1);
+  start = posrelat(luaL_checkinteger(L, 2), l);
+  end = posrelat(luaL_optinteger(L, 3, -1), l);
   if (start < 1) start = 1;
   if (end > (lua_Integer)l) end = l;
   if (start <= end)
-    lua_pushlstring(L, s + start - 1, (size_t)(end - start) + 1);
+    lua_pushsubstring(L, 1, (size_t)start - 1, (size_t)(end - start) + 1);
   else lua_pushliteral(L, "");
   return 1;
 }
@@ -188,11 +191,12 @@ static int writer (lua_State *L, const void *b, size_t size, void *B) {
 
 static int str_dump (lua_State *L) {
   luaL_Buffer b;
-  int strip = lua_toboolean(L, 2);
+  int opts = (lua_toboolean(L, 2) ? LUA_DUMPSTRIP : 0) |
+             (lua_toboolean(L, 3) ? LUA_DUMPCOMPRESS : 0);
   luaL_checktype(L, 1, LUA_TFUNCTION);
   lua_settop(L, 1);
   luaL_buffinit(L,&b);
-  if (lua_dump(L, writer, &b, strip) != 0)
+  if (lua_dump(L, writer, &b, opts) != 0)
     return luaL_error(L, "unable to dump given function");
   luaL_pushresult(&b);
   return 1;
@@ -21,6 +21,21 @@
 ** in its main position (i.e. the 'original' position that its hash gives
 ** to it), then the colliding element is in its own main position.
 ** Hence even when the load factor reaches 100%, performance remains good.
+** Large hash parts are resized incrementally: the table gets a new node
+** vector (usually with twice the size, but with the same or a smaller
+** size if most of its nodes hold removed keys) and its old nodes are
+** moved there a few at a time, at each insertion of a new key. Until
+** all of them are moved, keys not found in the new vector are searched
+** in the old one ('oldnode'). A moved node keeps its key (to preserve
+** its chain) but loses its value, so a key has a value in at most one of
+** the vectors.
+** An array part holding a sequence of integers only, or of floats only,
+** is 'packed' when the table is rehashed: it keeps the 'npacked' values
+** without their tags (so, half the memory), after a 'scratch' TValue
+** where 'luaH_getint' builds the element it returns. Other integer keys,
+** even those up to 'sizearray', go to the hash part. A store that does
+** not fit that layout (a value of another type, or a hole) unpacks the
+** array part again.
 */
 
 #include <math.h>
@@ -55,7 +70,33 @@
 #define MAXHBITS	(MAXABITS - 1)
 
 
-#define hashpow2(t,n)		(gnode(t, lmod((n), sizenode(t))))
+/*
+** Hash parts with at least 2^LUAI_INCRHBITS nodes are resized
+** incrementally, unless they grow because of a key that could go to
+** the array part (so that the array part can still take such keys).
+*/
+#if !defined(LUAI_INCRHBITS)
+#define LUAI_INCRHBITS	16
+#endif
+
+/* number of old nodes moved at each insertion during a resize */
+#if !defined(LUAI_INCRHSTEP)
+#define LUAI_INCRHSTEP	4
+#endif
+
+/* minimum size of an array part to be packed */
+#if !defined(LUAI_MINPACK)
+#define LUAI_MINPACK	8
+#endif
+
+/* type of the elements of a packed array part that could hold 'v' */
+#define packedtype(v)	(ttisnumber(v) ? ttype(v) : LUA_TNIL)
+
+
+/* main position of hash 'n' in a node vector 'v' with 2^'ls' nodes */
+#define hashpow2v(v,ls,n)	(&(v)[lmod((n), twoto(ls))])
+
+#define hashpow2(t,n)		hashpow2v((t)->node, (t)->lsizenode, n)
 
 #define hashstr(t,str)		hashpow2(t, (str)->hash)
 #define hashboolean(t,p)	hashpow2(t, p)
@@ -66,10 +107,10 @@
 ** for some types, it is better to avoid modulus by power of 2, as
 ** they tend to have many 2 factors.
 */
-#define hashmod(t,n)	(gnode(t, ((n) % ((sizenode(t)-1)|1))))
+#define hashmodv(v,ls,n)	(&(v)[(n) % ((twoto(ls)-1)|1)])
 
 
-#define hashpointer(t,p)	hashmod(t, point2uint(p))
+#define hashpointerv(v,ls,p)	hashmodv(v, ls, point2uint(p))
 
 
 #define dummynode		(&dummynode_)
@@ -111,29 +152,58 @@ static int l_hashfloat (lua_Number n) {
 
 
 /*
-** returns the 'main' position of an element in a table (that is, the index
-** of its hash value)
+** returns the 'main' position of an element in a node vector 'v' with
+** 2^'ls' nodes (that is, the index of its hash value)
 */
-static Node *mainposition (const Table *t, const TValue *key) {
+static Node *mainpositionv (Node *v, int ls, const TValue *key) {
   switch (ttype(key)) {
     case LUA_TNUMINT:
-      return hashint(t, ivalue(key));
+      return hashpow2v(v, ls, ivalue(key));
     case LUA_TNUMFLT:
-      return hashmod(t, l_hashfloat(fltvalue(key)));
+      return hashmodv(v, ls, l_hashfloat(fltvalue(key)));
     case LUA_TSHRSTR:
-      return hashstr(t, tsvalue(key));
+      return hashpow2v(v, ls, tsvalue(key)->hash);
     case LUA_TLNGSTR:
-      return hashpow2(t, luaS_hashlongstr(tsvalue(key)));
+      return hashpow2v(v, ls, luaS_hashlongstr(tsvalue(key)));
     case LUA_TBOOLEAN:
-      return hashboolean(t, bvalue(key));
+      return hashpow2v(v, ls, bvalue(key));
     case LUA_TLIGHTUSERDATA:
-      return hashpointer(t, pvalue(key));
+      return hashpointerv(v, ls, pvalue(key));
     case LUA_TLCF:
-      return hashpointer(t, fvalue(key));
+      return hashpointerv(v, ls, fvalue(key));
     default:
       lua_assert(!ttisdeadkey(key));
-      return hashpointer(t, gcvalue(key));
+      return hashpointerv(v, ls, gcvalue(key));
+  }
+}
+
+
+/* main position of an element in the hash part of a table */
+#define mainposition(t,k)	mainpositionv((t)->node, (t)->lsizenode, k)
+
+/* main position of an element in the old hash part of a table */
+#define mainpositionold(t,k)  \
+	mainpositionv((t)->oldnode, (t)->oldlsizenode, k)
+
+
+/*
+** search for 'key' in the old hash part of a table that is being
+** resized; only entries not moved yet (which have values) count
+*/
+static const TValue *getold (const Table *t, const TValue *key) {
+  if (t->oldnode != NULL) {
+    Node *n = mainpositionold(t, key);
+    for (;;) {  /* check whether 'key' is somewhere in the chain */
+      if (luaV_rawequalobj(gkey(n), key))
+        return ttisnil(gval(n)) ? luaO_nilobject : gval(n);
+      else {
+        int nx = gnext(n);
+        if (nx == 0) break;
+        n += nx;
+      }
+    }
   }
+  return luaO_nilobject;  /* not found */
 }
 
 
@@ -151,40 +221,64 @@ static unsigned int arrayindex (const TValue *key) {
 }
 
 
+/*
+** returns the node of 'key' in the chain starting at 'n', or NULL if
+** it is not there
+*/
+static Node *findnode (Node *n, const TValue *key) {
+  for (;;) {  /* check whether 'key' is somewhere in the chain */
+    /* key may be dead already, but it is ok to use it in 'next' */
+    if (luaV_rawequalobj(gkey(n), key) ||
+          (ttisdeadkey(gkey(n)) && iscollectable(key) &&
+           deadvalue(gkey(n)) == gcvalue(key)))
+      return n;
+    else {
+      int nx = gnext(n);
+      if (nx == 0) return NULL;
+      n += nx;
+    }
+  }
+}
+
+
 /*
 ** returns the index of a 'key' for table traversals. First goes all
-** elements in the array part, then elements in the hash part. The
-** beginning of a traversal is signaled by 0.
+** elements in the array part, then elements in the hash part, then
+** elements in the old hash part (during a resize). The beginning of a
+** traversal is signaled by 0.
 */
 static unsigned int findindex (lua_State *L, Table *t, StkId key) {
   unsigned int i;
+  Node *n;
   if (ttisnil(key)) return 0;  /* first iteration */
   i = arrayindex(key);
-  if (i != 0 && i <= t->sizearray)  /* is 'key' inside array part? */
-    return i;  /* yes; that's the index */
-  else {
-    int nx;
-    Node *n = mainposition(t, key);
-    for (;;) {  /* check whether 'key' is somewhere in the chain */
-      /* key may be dead already, but it is ok to use it in 'next' */
-      if (luaV_rawequalobj(gkey(n), key) ||
-            (ttisdeadkey(gkey(n)) && iscollectable(key) &&
-             deadvalue(gkey(n)) == gcvalue(key))) {
-        i = cast_int(n - gnode(t, 0));  /* key index in hash table */
-        /* hash elements are numbered after array ones */
-        return (i + 1) + t->sizearray;
-      }
-      nx = gnext(n);
-      if (nx == 0)
-        luaG_runerror(L, "invalid key to 'next'");  /* key not found */
-      else n += nx;
-    }
-  }
+  if (i != 0 && i <= t->sizearray && (!ispacked(t) || i <= t->npacked))
+    return i;  /* 'key' is inside array part; that's the index */
+  else if ((n = findnode(mainposition(t, key), key)) != NULL)
+    i = cast_int(n - gnode(t, 0));  /* key index in hash table */
+  else if (t->oldnode != NULL &&
+           (n = findnode(mainpositionold(t, key), key)) != NULL)
+    i = sizenode(t) + cast_int(n - t->oldnode);  /* old nodes come next */
+  else if (i != 0 && i <= t->sizearray)  /* removed from a packed part? */
+    return i;
+  else
+    luaG_runerror(L, "invalid key to 'next'");  /* key not found */
+  /* hash elements are numbered after array ones */
+  return (i + 1) + t->sizearray;
 }
 
 
 int luaH_next (lua_State *L, Table *t, StkId key) {
   unsigned int i = findindex(L, t, key);  /* find original element */
+  if (ispacked(t)) {  /* packed array part has no holes */
+    if (i < t->npacked) {
+      setivalue(key, i + 1);
+      setobj2s(L, key+1, luaH_getint(t, i + 1));
+      return 1;
+    }
+    else if (i < t->sizearray)
+      i = t->sizearray;  /* go to the hash part */
+  }
   for (; i < t->sizearray; i++) {  /* try first array part */
     if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
       setivalue(key, i + 1);
@@ -199,6 +293,13 @@ int luaH_next (lua_State *L, Table *t, StkId key) {
       return 1;
     }
   }
+  for (i -= sizenode(t); i < t->oldleft; i++) {  /* nodes not moved yet */
+    if (!ttisnil(gval(&t->oldnode[i]))) {  /* a non-nil value? */
+      setobj2s(L, key, gkey(&t->oldnode[i]));
+      setobj2s(L, key+1, gval(&t->oldnode[i]));
+      return 1;
+    }
+  }
   return 0;  /* no more elements */
 }
 
@@ -305,6 +406,20 @@ static void setarrayvector (lua_State *L, Table *t, unsigned int size) {
 }
 
 
+/* mark all nodes of the hash part of 't' (not a dummy one) as free */
+static void freenodes (Table *t) {
+  int size = sizenode(t);
+  int i;
+  for (i = 0; i < size; i++) {
+    Node *n = gnode(t, i);
+    gnext(n) = 0;
+    setnilvalue(wgkey(n));
+    setnilvalue(gval(n));
+  }
+  t->lastfree = gnode(t, size);  /* all positions are free */
+}
+
+
 static void setnodevector (lua_State *L, Table *t, unsigned int size) {
   if (size == 0) {  /* no elements to hash part? */
     t->node = cast(Node *, dummynode);  /* use common 'dummynode' */
@@ -312,20 +427,204 @@ static void setnodevector (lua_State *L, Table *t, unsigned int size) {
     t->lastfree = NULL;  /* signal that it is using dummy node */
   }
   else {
-    int i;
     int lsize = luaO_ceillog2(size);
     if (lsize > MAXHBITS)
       luaG_runerror(L, "table overflow");
     size = twoto(lsize);
     t->node = luaM_newvector(L, size, Node);
-    for (i = 0; i < (int)size; i++) {
-      Node *n = gnode(t, i);
-      gnext(n) = 0;
-      setnilvalue(wgkey(n));
-      setnilvalue(gval(n));
-    }
     t->lsizenode = cast_byte(lsize);
-    t->lastfree = gnode(t, size);  /* all positions are free */
+    freenodes(t);
+  }
+}
+
+
+static TValue *insertkey (lua_State *L, Table *t, const TValue *key);
+
+
+/*
+** Move up to 'n' nodes from the old hash part of 't' (if any) to its
+** hash part, starting from the last one; free the old hash part once
+** all its nodes are moved. Moved entries do not need barriers, as they
+** were already in the table.
+*/
+static void movenodes (lua_State *L, Table *t, unsigned int n) {
+  if (t->oldnode == NULL) return;  /* no resize going on */
+  for (; n > 0 && t->oldleft > 0; n--) {
+    Node *old = &t->oldnode[--t->oldleft];
+    if (!ttisnil(gval(old))) {
+      TValue *v = insertkey(L, t, gkey(old));
+      lua_assert(v != NULL);  /* new hash part has room for all entries */
+      setobj2t(L, v, gval(old));
+      setnilvalue(gval(old));  /* entry is now in the new hash part */
+    }
+  }
+  if (t->oldleft == 0) {  /* all nodes moved? */
+    luaM_freearray(L, t->oldnode, cast(size_t, allocsizeoldnode(t)));
+    t->oldnode = NULL;
+  }
+}
+
+
+#define finishmove(L,t)		movenodes(L, t, (t)->oldleft)
+
+
+/*
+** Start an incremental resize of table 't', giving it a hash part with
+** 'size' nodes. That size must give room for all live entries in the
+** old hash part plus one new entry for each LUAI_INCRHSTEP moved nodes,
+** so that the new part cannot get full before all old nodes are moved.
+*/
+static void startmove (lua_State *L, Table *t, unsigned int size) {
+  Node *old = t->node;
+  lu_byte oldlsize = t->lsizenode;
+  lua_assert(t->oldnode == NULL && !isdummy(t));
+  setnodevector(L, t, size);
+  t->oldnode = old;
+  t->oldlsizenode = oldlsize;
+  t->oldleft = twoto(oldlsize);
+}
+
+
+/*
+** Size for the incremental resize of the (large) hash part of 't', or
+** 0 if it should be resized at once. The new part keeps at most half
+** of its nodes with live entries: it doubles if the old one had more
+** than that, and otherwise it keeps or reduces its size, dropping the
+** nodes of removed keys. A part too small for the old nodes to be moved
+** before it gets full (see 'startmove') is resized at once.
+*/
+static unsigned int movesize (const Table *t) {
+  unsigned int oldsize = sizenode(t);
+  unsigned int live = 0;
+  unsigned int size, i;
+  for (i = 0; i < oldsize; i++) {
+    if (!ttisnil(gval(gnode(t, i))))
+      live++;
+  }
+  if (live >= oldsize / 2)
+    return 2 * oldsize;
+  size = twoto(luaO_ceillog2(2 * live + 1));
+  if (size < cast(unsigned int, twoto(LUAI_INCRHBITS)) ||
+      size < 2 * oldsize / LUAI_INCRHSTEP)
+    return 0;
+  return size;
+}
+
+
+/*
+** Convert the packed array part of 't' back to a regular one with the
+** same size, moving to it the keys in that range that are in the hash
+** part.
+*/
+static void unpackarray (lua_State *L, Table *t) {
+  unsigned int size = t->sizearray;
+  Value *old = cast(Value *, t->array);
+  TValue *a;
+  unsigned int i;
+  finishmove(L, t);  /* all entries must be in the hash part proper */
+  a = luaM_newvector(L, size, TValue);
+  for (i = 0; i < size; i++) {
+    if (i < t->npacked) {
+      TValue *io = &a[i];
+      val_(io) = old[PACKEDHEAD + i];
+      settt_(io, t->arraytype);
+    }
+    else
+      setnilvalue(&a[i]);
+  }
+  for (i = 0; i < cast(unsigned int, allocsizenode(t)); i++) {
+    Node *n = gnode(t, i);
+    unsigned int k = arrayindex(gkey(n));
+    if (!ttisnil(gval(n)) && k > t->npacked && k <= size) {
+      setobj2t(L, &a[k - 1], gval(n));
+      setnilvalue(gval(n));  /* entry is now in the array part */
+    }
+  }
+  luaM_freearray(L, old, size + PACKEDHEAD);
+  t->array = a;
+  t->arraytype = LUA_TNIL;
+  t->npacked = 0;
+}
+
+
+/*
+** Pack the array part of 't' if it is large enough and it holds a
+** sequence of integers only or of floats only. Key 'ek', about to be
+** inserted with value 'ev', must not break that layout: if it is an
+** index of the array part (or right after the sequence), it must be
+** the next element of the sequence.
+*/
+static void packarray (lua_State *L, Table *t, const TValue *ek,
+                                               const TValue *ev) {
+  unsigned int size = t->sizearray;
+  unsigned int n, i;
+  int tt = LUA_TNIL;
+  Value *v;
+  if (size < LUAI_MINPACK)
+    return;
+  for (n = 0; n < size && !ttisnil(&t->array[n]); n++) {
+    if (n == 0)
+      tt = packedtype(&t->array[0]);
+    if (ttype(&t->array[n]) != tt || tt == LUA_TNIL)
+      return;  /* not numbers of a single type */
+  }
+  for (i = n; i < size; i++) {
+    if (!ttisnil(&t->array[i]))
+      return;  /* not a sequence */
+  }
+  i = arrayindex(ek);
+  if (i != 0 && (i <= size || i == n + 1)) {  /* 'ek' goes to array? */
+    if (i != n + 1 || (n > 0 && ttype(ev) != tt))
+      return;
+    tt = packedtype(ev);
+  }
+  if (tt == LUA_TNIL)
+    return;  /* nothing to pack */
+  v = luaM_newvector(L, size + PACKEDHEAD, Value);
+  for (i = 0; i < n; i++)
+    v[PACKEDHEAD + i] = val_(&t->array[i]);
+  luaM_freearray(L, t->array, size);
+  t->array = cast(TValue *, v);
+  t->arraytype = cast_byte(tt);
+  settt_(t->array, tt);  /* scratch always has the type of the elements */
+  t->npacked = n;
+}
+
+
+/*
+** Store value 'v' at index 'k' of the packed array part of 't', where
+** 1 <= k <= npacked + 1 and 't[k]' is not in the hash part. Values of
+** the type of the array replace an element or are appended to it (the
+** array part doubles when full) and nil removes its last element; other
+** stores unpack the array part first.
+*/
+static void setpacked (lua_State *L, Table *t, unsigned int k,
+                                               const TValue *v) {
+  if (ttype(v) == t->arraytype) {
+    if (k > t->npacked) {  /* new element? */
+      if (k > t->sizearray) {  /* array part is full? */
+        Value *a = cast(Value *, t->array);
+        unsigned int size = t->sizearray;
+        if (size > MAXASIZE / 2)
+          luaG_runerror(L, "table overflow");
+        luaM_reallocvector(L, a, size + PACKEDHEAD, 2 * size + PACKEDHEAD,
+                           Value);
+        t->array = cast(TValue *, a);
+        t->sizearray = 2 * size;
+      }
+      t->npacked = k;
+    }
+    packedvalues(t)[k - 1] = val_(v);
+  }
+  else if (ttisnil(v) && k >= t->npacked) {  /* remove last element? */
+    if (k == t->npacked)
+      t->npacked--;
+  }
+  else {
+    TValue key;
+    unpackarray(L, t);
+    setivalue(&key, k);
+    luaH_finishset(L, t, &key, luaH_getint(t, k), v);
   }
 }
 
@@ -335,8 +634,13 @@ void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
   unsigned int i;
   int j;
   unsigned int oldasize = t->sizearray;
-  int oldhsize = allocsizenode(t);
-  Node *nold = t->node;  /* save old hash ... */
+  int oldhsize;
+  Node *nold;
+  finishmove(L, t);  /* all entries must be in the hash part proper */
+  if (ispacked(t))
+    unpackarray(L, t);
+  oldhsize = allocsizenode(t);
+  nold = t->node;  /* save old hash ... */
   if (nasize > oldasize)  /* array part must grow? */
     setarrayvector(L, t, nasize);
   /* create new hash part with appropriate size */
@@ -373,12 +677,23 @@ void luaH_resizearray (lua_State *L, Table *t, unsigned int nasize) {
 /*
 ** nums[i] = number of keys 'k' where 2^(i - 1) < k <= 2^i
 */
-static void rehash (lua_State *L, Table *t, const TValue *ek) {
+static void rehash (lua_State *L, Table *t, const TValue *ek,
+                                            const TValue *ev) {
   unsigned int asize;  /* optimal size for array part */
   unsigned int na;  /* number of keys in the array part */
   unsigned int nums[MAXABITS + 1];
   int i;
   int totaluse;
+  finishmove(L, t);  /* hash part got full before the end of a resize? */
+  if (sizenode(t) >= twoto(LUAI_INCRHBITS) && arrayindex(ek) == 0) {
+    unsigned int size = movesize(t);
+    if (size > 0) {
+      startmove(L, t, size);  /* large hash part: resize it incrementally */
+      return;
+    }
+  }
+  if (ispacked(t))
+    unpackarray(L, t);
   for (i = 0; i <= MAXABITS; i++) nums[i] = 0;  /* reset counts */
   na = numusearray(t, nums);  /* count keys in array part */
   totaluse = na;  /* all those keys are integer keys */
@@ -390,6 +705,7 @@ static void rehash (lua_State *L, Table *t, const TValue *ek) {
   asize = computesizes(nums, &na);
   /* resize the table to new computed sizes */
   luaH_resize(L, t, asize, totaluse - na);
+  packarray(L, t, ek, ev);
 }
 
 
@@ -406,15 +722,46 @@ Table *luaH_new (lua_State *L) {
   t->flags = cast_byte(~0);
   t->array = NULL;
   t->sizearray = 0;
+  t->oldnode = NULL;
+  t->oldleft = 0;
+  t->oldlsizenode = 0;
+  t->lenhint = 0;
+  t->arraytype = LUA_TNIL;
+  t->npacked = 0;
   setnodevector(L, t, 0);
   return t;
 }
 
 
+/*
+** Remove all entries from table 't', keeping the space of its array
+** and hash parts for new entries.
+*/
+void luaH_clear (lua_State *L, Table *t) {
+  unsigned int i;
+  if (t->oldnode != NULL) {  /* in the middle of a resize? */
+    luaM_freearray(L, t->oldnode, cast(size_t, allocsizeoldnode(t)));
+    t->oldnode = NULL;
+    t->oldleft = 0;
+  }
+  for (i = 0; i < sizetvarray(t); i++)
+    setnilvalue(&t->array[i]);
+  t->npacked = 0;
+  if (!isdummy(t))
+    freenodes(t);
+  invalidateTMcache(t);  /* 't' may be a metatable */
+}
+
+
 void luaH_free (lua_State *L, Table *t) {
+  if (t->oldnode != NULL)
+    luaM_freearray(L, t->oldnode, cast(size_t, allocsizeoldnode(t)));
   if (!isdummy(t))
     luaM_freearray(L, t->node, cast(size_t, sizenode(t)));
-  luaM_freearray(L, t->array, t->sizearray);
+  if (ispacked(t))
+    luaM_freearray(L, cast(Value *, t->array), t->sizearray + PACKEDHEAD);
+  else
+    luaM_freearray(L, t->array, t->sizearray);
   luaM_free(L, t);
 }
 
@@ -433,34 +780,20 @@ static Node *getfreepos (Table *t) {
 
 
 /*
-** inserts a new key into a hash table; first, check whether key's main
-** position is free. If not, check whether colliding node is in its main
-** position or not: if it is not, move colliding node to an empty place and
-** put new key in its main position; otherwise (colliding node is in its main
-** position), new key goes to an empty position.
+** inserts a new key into the hash part of a table; first, check whether
+** key's main position is free. If not, check whether colliding node is in
+** its main position or not: if it is not, move colliding node to an empty
+** place and put new key in its main position; otherwise (colliding node is
+** in its main position), new key goes to an empty position. Returns NULL
+** if there is no empty position.
 */
-TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
-  Node *mp;
-  TValue aux;
-  if (ttisnil(key)) luaG_runerror(L, "table index is nil");
-  else if (ttisfloat(key)) {
-    lua_Integer k;
-    if (luaV_tointeger(key, &k, 0)) {  /* does index fit in an integer? */
-      setivalue(&aux, k);
-      key = &aux;  /* insert it as an integer */
-    }
-    else if (luai_numisnan(fltvalue(key)))
-      luaG_runerror(L, "table index is NaN");
-  }
-  mp = mainposition(t, key);
+static TValue *insertkey (lua_State *L, Table *t, const TValue *key) {
+  Node *mp = mainposition(t, key);
   if (!ttisnil(gval(mp)) || isdummy(t)) {  /* main position is taken? */
     Node *othern;
     Node *f = getfreepos(t);  /* get a free place */
-    if (f == NULL) {  /* cannot find a free place? */
-      rehash(L, t, key);  /* grow table */
-      /* whatever called 'newkey' takes care of TM cache */
-      return luaH_set(L, t, key);  /* insert key into grown table */
-    }
+    if (f == NULL)  /* cannot find a free place? */
+      return NULL;
     lua_assert(!isdummy(t));
     othern = mainposition(t, gkey(mp));
     if (othern != mp) {  /* is colliding node out of its main position? */
@@ -485,19 +818,55 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
     }
   }
   setnodekey(L, &mp->i_key, key);
-  luaC_barrierback(L, t, key);
   lua_assert(ttisnil(gval(mp)));
   return gval(mp);
 }
 
 
+/*
+** inserts a new key with a given value into a table, growing it if
+** needed. During an incremental resize, each insertion also moves some
+** old nodes. The key must not be an index of a packed array part (see
+** 'luaH_finishset').
+*/
+void luaH_newkey (lua_State *L, Table *t, const TValue *key,
+                                          const TValue *value) {
+  TValue *v;
+  TValue aux;
+  if (ttisnil(key)) luaG_runerror(L, "table index is nil");
+  else if (ttisfloat(key)) {
+    lua_Integer k;
+    if (luaV_tointeger(key, &k, 0)) {  /* does index fit in an integer? */
+      setivalue(&aux, k);
+      key = &aux;  /* insert it as an integer */
+    }
+    else if (luai_numisnan(fltvalue(key)))
+      luaG_runerror(L, "table index is NaN");
+  }
+  movenodes(L, t, LUAI_INCRHSTEP);
+  v = insertkey(L, t, key);
+  if (v == NULL) {  /* cannot find a free place? */
+    rehash(L, t, key, value);  /* grow table */
+    /* whatever called 'newkey' takes care of TM cache and barrier */
+    luaH_finishset(L, t, key, luaH_get(t, key), value);
+    return;
+  }
+  luaC_barrierback(L, t, key);
+  setobj2t(L, v, value);
+}
+
+
 /*
 ** search function for integers
 */
 const TValue *luaH_getint (Table *t, lua_Integer key) {
   /* (1 <= key && key <= t->sizearray) */
-  if (l_castS2U(key) - 1 < t->sizearray)
+  if (l_castS2U(key) - 1 < t->sizearray && !ispacked(t))
     return &t->array[key - 1];
+  else if (l_castS2U(key) - 1 < t->npacked) {  /* in packed array part? */
+    val_(t->array) = packedvalues(t)[key - 1];  /* fill scratch */
+    return t->array;
+  }
   else {
     Node *n = hashint(t, key);
     for (;;) {  /* check whether 'key' is somewhere in the chain */
@@ -509,11 +878,28 @@ const TValue *luaH_getint (Table *t, lua_Integer key) {
         n += nx;
       }
     }
+    if (t->oldnode != NULL) {  /* in the middle of a resize? */
+      TValue k;
+      setivalue(&k, key);
+      return getold(t, &k);
+    }
     return luaO_nilobject;
   }
 }
 
 
+/* search for a short string in the old hash part of a table (if any) */
+static const TValue *getoldstr (Table *t, TString *key) {
+  if (t->oldnode == NULL)
+    return luaO_nilobject;
+  else {
+    TValue ko;
+    setsvalue(cast(lua_State *, NULL), &ko, key);
+    return getold(t, &ko);
+  }
+}
+
+
 /*
 ** search function for short strings
 */
@@ -527,7 +913,31 @@ const TValue *luaH_getshortstr (Table *t, TString *key) {
     else {
       int nx = gnext(n);
       if (nx == 0)
-        return luaO_nilobject;  /* not found */
+        return getoldstr(t, key);  /* not found */
+      n += nx;
+    }
+  }
+}
+
+
+/*
+** search function for short strings that also records in 'hint' the
+** node where it found the key, for the inline caches of the VM
+*/
+const TValue *luaH_getshortstrhint (Table *t, TString *key,
+                                    unsigned int *hint) {
+  Node *n = hashstr(t, key);
+  lua_assert(key->tt == LUA_TSHRSTR);
+  for (;;) {  /* check whether 'key' is somewhere in the chain */
+    const TValue *k = gkey(n);
+    if (ttisshrstring(k) && eqshrstr(tsvalue(k), key)) {
+      *hint = cast(unsigned int, n - gnode(t, 0));
+      return gval(n);  /* that's it */
+    }
+    else {
+      int nx = gnext(n);
+      if (nx == 0)
+        return getoldstr(t, key);  /* not found (hint stays unchanged) */
       n += nx;
     }
   }
@@ -546,7 +956,7 @@ static const TValue *getgeneric (Table *t, const TValue *key) {
     else {
       int nx = gnext(n);
       if (nx == 0)
-        return luaO_nilobject;  /* not found */
+        return getold(t, key);  /* not found */
       n += nx;
     }
   }
@@ -584,29 +994,67 @@ const TValue *luaH_get (Table *t, const TValue *key) {
 }
 
 
+/*
+** If 'key' is an index of the packed array part of 't' or the index
+** right after its last element, return that index; otherwise, return 0.
+*/
+static unsigned int packedindex (const Table *t, const TValue *key) {
+  lua_Integer k;
+  if (ttisinteger(key))
+    k = ivalue(key);
+  else if (!ttisfloat(key) || !luaV_tointeger(key, &k, 0))
+    return 0;
+  return (l_castS2U(k) - 1u <= t->npacked) ? cast(unsigned int, k) : 0;
+}
+
+
 /*
 ** beware: when using this function you probably need to check a GC
-** barrier and invalidate the TM cache.
+** barrier and invalidate the TM cache. The returned slot is a TValue
+** of the table, so a packed array part that could hold 'key' is
+** unpacked first.
 */
 TValue *luaH_set (lua_State *L, Table *t, const TValue *key) {
-  const TValue *p = luaH_get(t, key);
+  const TValue *p;
+  if (ispacked(t) && packedindex(t, key) != 0)
+    unpackarray(L, t);
+  p = luaH_get(t, key);
   if (p != luaO_nilobject)
     return cast(TValue *, p);
-  else return luaH_newkey(L, t, key);
+  else {
+    luaH_newkey(L, t, key, luaO_nilobject);
+    return cast(TValue *, luaH_get(t, key));
+  }
+}
+
+
+/*
+** Finish a raw assignment 't[key] = value', where 'slot' is the result
+** of 'luaH_get(t, key)': store the value in that slot, in a new entry
+** or in the packed array part. As with 'luaH_set', the caller must
+** check a GC barrier and invalidate the TM cache.
+*/
+void luaH_finishset (lua_State *L, Table *t, const TValue *key,
+                     const TValue *slot, const TValue *value) {
+  unsigned int k = ispacked(t) ? packedindex(t, key) : 0;
+  if (k != 0 && (k <= t->npacked || ttisnil(slot)))
+    setpacked(L, t, k, value);
+  else if (slot == luaO_nilobject)
+    luaH_newkey(L, t, key, value);
+  else
+    setobj2t(L, cast(TValue *, slot), value);
 }
 
 
 void luaH_setint (lua_State *L, Table *t, lua_Integer key, TValue *value) {
   const TValue *p = luaH_getint(t, key);
-  TValue *cell;
-  if (p != luaO_nilobject)
-    cell = cast(TValue *, p);
+  if (p != luaO_nilobject && !isscratch(t, p))
+    setobj2t(L, cast(TValue *, p), value);
   else {
     TValue k;
     setivalue(&k, key);
-    cell = luaH_newkey(L, t, &k);
+    luaH_finishset(L, t, &k, p, value);
   }
-  setobj2t(L, cell, value);
 }
 
 
@@ -635,10 +1083,10 @@ static int unbound_search (Table *t, unsigned int j) {
 
 
 /*
-** Try to find a boundary in table 't'. A 'boundary' is an integer index
-** such that t[i] is non-nil and t[i+1] is nil (and 0 if t[1] is nil).
+** Find a boundary in table 't' from scratch: a binary search in the
+** array part or an unbound search in the hash part.
 */
-int luaH_getn (Table *t) {
+static unsigned int getborder (Table *t) {
   unsigned int j = t->sizearray;
   if (j > 0 && ttisnil(&t->array[j - 1])) {
     /* there is a boundary in the array part: (binary) search for it */
@@ -657,6 +1105,42 @@ int luaH_getn (Table *t) {
 }
 
 
+/* true if 't[i]' is nil ('i' > 0) */
+static int isnilint (Table *t, unsigned int i) {
+  if (i - 1 < t->sizearray)
+    return ttisnil(&t->array[i - 1]);
+  else
+    return ttisnil(luaH_getint(t, i));
+}
+
+
+/*
+** Try to find a boundary in table 't'. A 'boundary' is an integer index
+** such that t[i] is non-nil and t[i+1] is nil (and 0 if t[1] is nil).
+** First check the boundary found by the previous call and its neighbors;
+** so, the length of a table that grows or shrinks at its end (as in
+** 't[#t + 1] = v') is found in constant time.
+*/
+int luaH_getn (Table *t) {
+  unsigned int h = t->lenhint;
+  if (ispacked(t)) {  /* packed array part has no holes */
+    if (ttisnil(luaH_getint(t, t->npacked + 1)))
+      return cast_int(t->npacked);
+    else
+      return unbound_search(t, t->npacked);
+  }
+  if (h == 0 || !isnilint(t, h)) {  /* t[h] is present? */
+    if (isnilint(t, h + 1))
+      return cast_int(h);  /* 'h' is still a boundary */
+    else if (isnilint(t, h + 2))
+      return cast_int(t->lenhint = h + 1);  /* one element was added */
+  }
+  else if (h == 1 || !isnilint(t, h - 1))
+    return cast_int(t->lenhint = h - 1);  /* one element was removed */
+  return cast_int(t->lenhint = getborder(t));
+}
+
+
 
 #if defined(LUA_DEBUG)
 
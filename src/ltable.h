@@ -35,6 +35,33 @@
 #define allocsizenode(t)	(isdummy(t) ? 0 : sizenode(t))
 
 
+/* allocated size for old hash nodes */
+#define allocsizeoldnode(t)  \
+	((t)->oldnode == NULL ? 0 : twoto((t)->oldlsizenode))
+
+
+/* true when the array part of 't' is packed (see ltable.c) */
+#define ispacked(t)		((t)->arraytype != LUA_TNIL)
+
+/* true when 'slot' is an element read from the packed array part of 't' */
+#define isscratch(t,slot)	((slot) == (t)->array && ispacked(t))
+
+/* number of 'Value's before the elements of a packed array part */
+#define PACKEDHEAD  \
+	cast(unsigned int, (sizeof(TValue) + sizeof(Value) - 1) / sizeof(Value))
+
+/* elements of the packed array part of 't' */
+#define packedvalues(t)		(cast(Value *, (t)->array) + PACKEDHEAD)
+
+/* number of 'TValue's in the array part of 't' */
+#define sizetvarray(t)		(ispacked(t) ? 0 : (t)->sizearray)
+
+/* size in bytes of the array part of 't' */
+#define arraymem(t)  \
+	(ispacked(t) ? sizeof(Value) * ((t)->sizearray + PACKEDHEAD) \
+	             : sizeof(TValue) * (t)->sizearray)
+
+
 /* returns the key, given the value of a table entry */
 #define keyfromval(v) \
   (gkey(cast(Node *, cast(char *, (v)) - offsetof(Node, i_val))))
@@ -44,14 +71,20 @@ LUAI_FUNC const TValue *luaH_getint (Table *t, lua_Integer key);
 LUAI_FUNC void luaH_setint (lua_State *L, Table *t, lua_Integer key,
                                                     TValue *value);
 LUAI_FUNC const TValue *luaH_getshortstr (Table *t, TString *key);
+LUAI_FUNC const TValue *luaH_getshortstrhint (Table *t, TString *key,
+                                              unsigned int *hint);
 LUAI_FUNC const TValue *luaH_getstr (Table *t, TString *key);
 LUAI_FUNC const TValue *luaH_get (Table *t, const TValue *key);
-LUAI_FUNC TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key);
+LUAI_FUNC void luaH_newkey (lua_State *L, Table *t, const TValue *key,
+                                                 const TValue *value);
 LUAI_FUNC TValue *luaH_set (lua_State *L, Table *t, const TValue *key);
+LUAI_FUNC void luaH_finishset (lua_State *L, Table *t, const TValue *key,
+                               const TValue *slot, const TValue *value);
 LUAI_FUNC Table *luaH_new (lua_State *L);
 LUAI_FUNC void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
                                                     unsigned int nhsize);
 LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, unsigned int nasize);
+LUAI_FUNC void luaH_clear (lua_State *L, Table *t);
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
 LUAI_FUNC int luaH_next (lua_State *L, Table *t, StkId key);
 LUAI_FUNC int luaH_getn (Table *t);
@@ -157,6 +157,31 @@ static int tmove (lua_State *L) {
 }
 
 
+/*
+** Create a table with space for 'narr' array elements and 'nrec'
+** other fields, so that filling it up to those sizes needs no rehash.
+*/
+static int tnew (lua_State *L) {
+  lua_Integer narr = luaL_optinteger(L, 1, 0);
+  lua_Integer nrec = luaL_optinteger(L, 2, 0);
+  luaL_argcheck(L, 0 <= narr && narr <= INT_MAX, 1, "size out of range");
+  luaL_argcheck(L, 0 <= nrec && nrec <= INT_MAX, 2, "size out of range");
+  lua_createtable(L, (int)narr, (int)nrec);
+  return 1;
+}
+
+
+/*
+** Remove all fields of a table, keeping its allocated space, so that
+** it can be refilled without allocations. (Metamethods are ignored.)
+*/
+static int tclear (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_cleartable(L, 1);
+  return 0;
+}
+
+
 static void addfield (lua_State *L, luaL_Buffer *b, lua_Integer i) {
   lua_geti(L, 1, i);
   if (!lua_isstring(L, -1))
@@ -424,11 +449,13 @@ static int sort (lua_State *L) {
 
 
 static const luaL_Reg tab_funcs[] = {
+  {"clear", tclear},
   {"concat", tconcat},
 #if defined(LUA_COMPAT_MAXN)
   {"maxn", maxn},
 #endif
   {"insert", tinsert},
+  {"new", tnew},
   {"pack", pack},
   {"unpack", unpack},
   {"remove", tremove},
@@ -129,7 +129,8 @@ static void laction (int i) {
 
 static void print_usage (const char *badoption) {
   lua_writestringerror("%s: ", progname);
-  if (badoption[1] == 'e' || badoption[1] == 'l')
+  if (badoption[1] == 'e' || badoption[1] == 'j' || badoption[1] == 'l' ||
+      badoption[1] == 'p')
     lua_writestringerror("'%s' needs argument\n", badoption);
   else
     lua_writestringerror("unrecognized option '%s'\n", badoption);
@@ -138,7 +139,9 @@ static void print_usage (const char *badoption) {
   "Available options are:\n"
   "  -e stat  execute string 'stat'\n"
   "  -i       enter interactive mode after executing 'script'\n"
+  "  -j mode  turn the JIT compiler 'on' or 'off'\n"
   "  -l name  require library 'name'\n"
+  "  -p file  profile execution, writing folded stacks to 'file'\n"
   "  -v       show version information\n"
   "  -E       ignore environment variables\n"
   "  --       stop handling options\n"
@@ -491,7 +494,9 @@ static int collectargs (char **argv, int *first) {
         break;
       case 'e':
         args |= has_e;  /* FALLTHROUGH */
-      case 'l':  /* both options need an argument */
+      case 'j':  /* FALLTHROUGH */
+      case 'l':  /* FALLTHROUGH */
+      case 'p':  /* these options need an argument */
         if (argv[i][2] == '\0') {  /* no concatenated argument? */
           i++;  /* try next 'argv' */
           if (argv[i] == NULL || argv[i][0] == '-')
@@ -508,15 +513,61 @@ static int collectargs (char **argv, int *first) {
 
 
 /*
-** Processes options 'e' and 'l', which involve running Lua code.
-** Returns 0 if some code raises an error.
+** Sets the mode of the JIT compiler
+*/
+static int dojit (lua_State *L, const char *mode) {
+  if (strcmp(mode, "on") == 0)
+    lua_jit(L, LUA_JITON);
+  else if (strcmp(mode, "off") == 0)
+    lua_jit(L, LUA_JITOFF);
+  else {
+    lua_pushfstring(L, "unknown JIT mode '%s'", mode);
+    return report(L, LUA_ERRRUN);
+  }
+  return LUA_OK;
+}
+
+
+/*
+** Starts the sampling profiler, which writes its results to 'fname'
+** when the state is closed.
+*/
+static int doprofile (lua_State *L, const char *fname) {
+  int status;
+  lua_getglobal(L, "require");
+  lua_pushliteral(L, LUA_PROFLIBNAME);
+  status = docall(L, 1, 1);  /* call 'require("profiler")' */
+  if (status == LUA_OK) {
+    lua_getfield(L, -1, "start");
+    lua_remove(L, -2);  /* remove library */
+    lua_pushnil(L);  /* default interval */
+    lua_pushstring(L, fname);
+    status = docall(L, 2, 0);  /* call 'start(nil, fname)' */
+  }
+  return report(L, status);
+}
+
+
+/*
+** Processes options 'e', 'j', 'l' and 'p' (which involve running Lua
+** code), in order. Returns 0 if some code raises an error.
 */
 static int runargs (lua_State *L, char **argv, int n) {
   int i;
   for (i = 1; i < n; i++) {
     int option = argv[i][1];
     lua_assert(argv[i][0] == '-');  /* already checked */
-    if (option == 'e' || option == 'l') {
+    if (option == 'j') {
+      const char *extra = argv[i] + 2;
+      if (*extra == '\0') extra = argv[++i];
+      if (dojit(L, extra) != LUA_OK) return 0;
+    }
+    else if (option == 'p') {
+      const char *extra = argv[i] + 2;
+      if (*extra == '\0') extra = argv[++i];
+      if (doprofile(L, extra) != LUA_OK) return 0;
+    }
+    else if (option == 'e' || option == 'l') {
       int status;
       const char *extra = argv[i] + 2;  /* both options need an argument */
       if (*extra == '\0') extra = argv[++i];
@@ -574,7 +625,7 @@ static int pmain (lua_State *L) {
     if (handle_luainit(L) != LUA_OK)  /* run LUA_INIT */
       return 0;  /* error running LUA_INIT */
   }
-  if (!runargs(L, argv, script))  /* execute arguments -e and -l */
+  if (!runargs(L, argv, script))  /* execute arguments -e, -j, -l and -p */
     return 0;  /* something failed */
   if (script < argc &&  /* execute main script (if there is one) */
       handle_script(L, argv + script) != LUA_OK)
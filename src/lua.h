@@ -226,6 +226,8 @@ LUA_API void        (lua_pushnumber) (lua_State *L, lua_Number n);
 LUA_API void        (lua_pushinteger) (lua_State *L, lua_Integer n);
 LUA_API const char *(lua_pushlstring) (lua_State *L, const char *s, size_t len);
 LUA_API const char *(lua_pushstring) (lua_State *L, const char *s);
+LUA_API void        (lua_pushsubstring) (lua_State *L, int idx, size_t i,
+                                                       size_t len);
 LUA_API const char *(lua_pushvfstring) (lua_State *L, const char *fmt,
                                                       va_list argp);
 LUA_API const char *(lua_pushfstring) (lua_State *L, const char *fmt, ...);
@@ -280,7 +282,11 @@ LUA_API int   (lua_pcallk) (lua_State *L, int nargs, int nresults, int errfunc,
 LUA_API int   (lua_load) (lua_State *L, lua_Reader reader, void *dt,
                           const char *chunkname, const char *mode);
 
-LUA_API int (lua_dump) (lua_State *L, lua_Writer writer, void *data, int strip);
+/* options for 'lua_dump' */
+#define LUA_DUMPSTRIP		1
+#define LUA_DUMPCOMPRESS	2
+
+LUA_API int (lua_dump) (lua_State *L, lua_Writer writer, void *data, int flags);
 
 
 /*
@@ -308,10 +314,37 @@ LUA_API int (lua_isyieldable) (lua_State *L);
 #define LUA_GCSETPAUSE		6
 #define LUA_GCSETSTEPMUL	7
 #define LUA_GCISRUNNING		9
+#define LUA_GCSETSTRGROW	10
+#define LUA_GCSETSTRSHRINK	11
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
 
 
+/*
+** statistics of the string table (of short strings)
+*/
+
+typedef struct lua_StrStats {
+  int size;  /* number of slots */
+  int nuse;  /* number of strings */
+  int maxchain;  /* number of strings in the longest chain */
+  size_t hits;  /* lookups that found an existing string */
+  size_t misses;  /* lookups that created a new string */
+} lua_StrStats;
+
+LUA_API void (lua_strstats) (lua_State *L, lua_StrStats *st);
+
+
+/*
+** JIT compiler modes
+*/
+
+#define LUA_JITOFF		0
+#define LUA_JITON		1
+
+LUA_API int (lua_jit) (lua_State *L, int mode);
+
+
 /*
 ** miscellaneous functions
 */
@@ -319,6 +352,7 @@ LUA_API int (lua_gc) (lua_State *L, int what, int data);
 LUA_API int   (lua_error) (lua_State *L);
 
 LUA_API int   (lua_next) (lua_State *L, int idx);
+LUA_API void  (lua_cleartable) (lua_State *L, int idx);
 
 LUA_API void  (lua_concat) (lua_State *L, int n);
 LUA_API void  (lua_len)    (lua_State *L, int idx);
@@ -404,6 +438,7 @@ LUA_API void      (lua_setallocf) (lua_State *L, lua_Alloc f, void *ud);
 #define LUA_HOOKLINE	2
 #define LUA_HOOKCOUNT	3
 #define LUA_HOOKTAILCALL 4
+#define LUA_HOOKSAMPLE	5
 
 
 /*
@@ -437,6 +472,9 @@ LUA_API lua_Hook (lua_gethook) (lua_State *L);
 LUA_API int (lua_gethookmask) (lua_State *L);
 LUA_API int (lua_gethookcount) (lua_State *L);
 
+LUA_API void (lua_setsampler) (lua_State *L, lua_Hook func);
+LUA_API void (lua_sample) (lua_State *L);
+
 
 struct lua_Debug {
   int event;
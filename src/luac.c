@@ -31,6 +31,7 @@ static void PrintFunction(const Proto* f, int full);
 static int listing=0;			/* list bytecodes? */
 static int dumping=1;			/* dump bytecodes? */
 static int stripping=0;			/* strip debug information? */
+static int compressing=0;		/* compress output? */
 static char Output[]={ OUTPUT };	/* default output file name */
 static const char* output=Output;	/* actual output file name */
 static const char* progname=PROGNAME;	/* actual program name */
@@ -61,6 +62,7 @@ static void usage(const char* message)
   "  -p       parse only\n"
   "  -s       strip debug information\n"
   "  -v       show version information\n"
+  "  -z       compress output\n"
   "  --       stop handling options\n"
   "  -        stop handling options and process stdin\n"
   ,progname,Output);
@@ -101,6 +103,8 @@ static int doargs(int argc, char* argv[])
    stripping=1;
   else if (IS("-v"))			/* show version */
    ++version;
+  else if (IS("-z"))			/* compress output */
+   compressing=1;
   else					/* unknown option */
    usage(argv[i]);
  }
@@ -181,7 +185,8 @@ static int pmain(lua_State* L)
   FILE* D= (output==NULL) ? stdout : fopen(output,"wb");
   if (D==NULL) cannot("open");
   lua_lock(L);
-  luaU_dump(L,f,writer,D,stripping);
+  luaU_dump(L,f,writer,D,(stripping ? LUA_DUMPSTRIP : 0) |
+                        (compressing ? LUA_DUMPCOMPRESS : 0));
   lua_unlock(L);
   if (ferror(D)) cannot("write");
   if (fclose(D)) cannot("close");
@@ -299,7 +304,7 @@ static void PrintCode(const Proto* f)
   int ax=GETARG_Ax(i);
   int bx=GETARG_Bx(i);
   int sbx=GETARG_sBx(i);
-  int line=getfuncline(f,pc);
+  int line=luaG_getfuncline(f,pc);
   printf("\t%d\t",pc+1);
   if (line>0) printf("[%d]\t",line); else printf("[-]\t");
   printf("%-9s\t",luaP_opnames[o]);
@@ -322,7 +327,7 @@ static void PrintCode(const Proto* f)
     printf("%d",MYK(ax));
     break;
   }
-  switch (o)
+  switch (genericop(o))
   {
    case OP_LOADK:
     printf("\t; "); PrintConstant(f,bx);
@@ -17,9 +17,12 @@
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
+#include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstring.h"
+#include "ltable.h"
 #include "lundump.h"
 #include "lzio.h"
 
@@ -33,6 +36,9 @@ typedef struct {
   lua_State *L;
   ZIO *Z;
   const char *name;
+  Table *strings;  /* strings of the chunk; a lazy load keeps its image at 0 */
+  int nstrings;
+  int lazy;
 } LoadState;
 
 
@@ -58,16 +64,34 @@ static void LoadBlock (LoadState *S, void *b, size_t size) {
 
 
 static lu_byte LoadByte (LoadState *S) {
-  lu_byte x;
-  LoadVar(S, x);
+  int b = zgetc(S->Z);
+  if (b == EOZ)
+    error(S, "truncated");
+  return cast_byte(b);
+}
+
+
+static size_t LoadUnsigned (LoadState *S, size_t limit) {
+  size_t x = 0;
+  int b;
+  limit >>= 7;
+  do {
+    b = LoadByte(S);
+    if (x >= limit)
+      error(S, "integer overflow in");
+    x = (x << 7) | (b & 0x7f);
+  } while ((b & 0x80) == 0);
   return x;
 }
 
 
+static size_t LoadSize (LoadState *S) {
+  return LoadUnsigned(S, MAX_SIZET);
+}
+
+
 static int LoadInt (LoadState *S) {
-  int x;
-  LoadVar(S, x);
-  return x;
+  return cast_int(LoadUnsigned(S, INT_MAX));
 }
 
 
@@ -86,29 +110,62 @@ static lua_Integer LoadInteger (LoadState *S) {
 
 
 static TString *LoadString (LoadState *S) {
-  size_t size = LoadByte(S);
-  if (size == 0xFF)
-    LoadVar(S, size);
-  if (size == 0)
+  int i = LoadInt(S);
+  if (i == 0)
     return NULL;
-  else if (--size <= LUAI_MAXSHORTLEN) {  /* short string? */
+  else if (i > S->nstrings)
+    error(S, "corrupted");
+  return tsvalue(&S->strings->array[i]);
+}
+
+
+static TString *NewString (LoadState *S, size_t size) {
+  if (size <= LUAI_MAXSHORTLEN) {  /* short string? */
     char buff[LUAI_MAXSHORTLEN];
     LoadVector(S, buff, size);
     return luaS_newlstr(S->L, buff, size);
   }
   else {  /* long string */
-    TString *ts = luaS_createlngstrobj(S->L, size);
+    TString *ts;
+    if (size >= (MAX_SIZE - sizeof(TString))/sizeof(char))
+      error(S, "corrupted");
+    ts = luaS_createlngstrobj(S->L, size);
     LoadVector(S, getstr(ts), size);  /* load directly in final place */
     return ts;
   }
 }
 
 
+/*
+** Load the string table of the chunk into 'S->strings' (an array
+** anchored on the stack); entry 0 is reserved for the image of a lazy
+** load.
+*/
+static void LoadStrings (LoadState *S) {
+  lua_State *L = S->L;
+  int i;
+  int n = LoadInt(S);
+  if (n == INT_MAX)
+    error(S, "corrupted");
+  S->strings = luaH_new(L);
+  sethvalue(L, L->top, S->strings);
+  luaD_inctop(L);
+  luaH_resize(L, S->strings, n + 1, 0);
+  S->nstrings = n;
+  for (i = 1; i <= n; i++) {
+    TString *ts = NewString(S, LoadSize(S));
+    setsvalue2n(L, &S->strings->array[i], ts);
+  }
+}
+
+
 static void LoadCode (LoadState *S, Proto *f) {
   int n = LoadInt(S);
   f->code = luaM_newvector(S->L, n, Instruction);
   f->sizecode = n;
   LoadVector(S, f->code, n);
+  luaP_fuse(f->code, n);
+  luaF_newicache(S->L, f);
 }
 
 
@@ -139,16 +196,26 @@ static void LoadConstants (LoadState *S, Proto *f) {
       setivalue(o, LoadInteger(S));
       break;
     case LUA_TSHRSTR:
-    case LUA_TLNGSTR:
-      setsvalue2n(S->L, o, LoadString(S));
+    case LUA_TLNGSTR: {
+      TString *ts = LoadString(S);
+      if (ts == NULL)
+        error(S, "corrupted");
+      setsvalue2n(S->L, o, ts);
       break;
+    }
     default:
-      lua_assert(0);
+      error(S, "corrupted");
     }
   }
 }
 
 
+/*
+** Each nested function comes preceded by its size. A lazy load does not
+** decode it: the function gets an empty prototype that only records its
+** position in the chunk image, and 'luaU_loadproto' decodes it the first
+** time it is needed.
+*/
 static void LoadProtos (LoadState *S, Proto *f) {
   int i;
   int n = LoadInt(S);
@@ -157,8 +224,22 @@ static void LoadProtos (LoadState *S, Proto *f) {
   for (i = 0; i < n; i++)
     f->p[i] = NULL;
   for (i = 0; i < n; i++) {
-    f->p[i] = luaF_newproto(S->L);
-    LoadFunction(S, f->p[i], f->source);
+    Proto *p = f->p[i] = luaF_newproto(S->L);
+    if (!S->lazy) {
+      LoadSize(S);  /* size is not needed */
+      LoadFunction(S, p, f->source);
+    }
+    else {
+      const char *image = getstr(tsvalue(&S->strings->array[0]));
+      size_t pos = cast(size_t, S->Z->p - image);
+      size_t size = LoadSize(S);
+      if (size > S->Z->n)
+        error(S, "truncated");
+      S->Z->p += size;  /* skip function */
+      S->Z->n -= size;
+      p->image = S->strings;
+      p->imageoff = pos;
+    }
   }
 }
 
@@ -180,10 +261,17 @@ static void LoadUpvalues (LoadState *S, Proto *f) {
 static void LoadDebug (LoadState *S, Proto *f) {
   int i, n;
   n = LoadInt(S);
-  f->lineinfo = luaM_newvector(S->L, n, int);
+  f->lineinfo = luaM_newvector(S->L, n, ls_byte);
   f->sizelineinfo = n;
   LoadVector(S, f->lineinfo, n);
   n = LoadInt(S);
+  f->abslineinfo = luaM_newvector(S->L, n, AbsLineInfo);
+  f->sizeabslineinfo = n;
+  for (i = 0; i < n; i++) {
+    f->abslineinfo[i].pc = LoadInt(S);
+    f->abslineinfo[i].line = LoadInt(S);
+  }
+  n = LoadInt(S);
   f->locvars = luaM_newvector(S->L, n, LocVar);
   f->sizelocvars = n;
   for (i = 0; i < n; i++)
@@ -194,6 +282,8 @@ static void LoadDebug (LoadState *S, Proto *f) {
     f->locvars[i].endpc = LoadInt(S);
   }
   n = LoadInt(S);
+  if (n > f->sizeupvalues)
+    error(S, "corrupted");
   for (i = 0; i < n; i++)
     f->upvalues[i].name = LoadString(S);
 }
@@ -240,8 +330,6 @@ static void checkHeader (LoadState *S) {
   if (LoadByte(S) != LUAC_FORMAT)
     error(S, "format mismatch in");
   checkliteral(S, LUAC_DATA, "corrupted");
-  checksize(S, int);
-  checksize(S, size_t);
   checksize(S, Instruction);
   checksize(S, lua_Integer);
   checksize(S, lua_Number);
@@ -252,28 +340,149 @@ static void checkHeader (LoadState *S) {
 }
 
 
+static void setname (LoadState *S, const char *name) {
+  if (*name == '@' || *name == '=')
+    S->name = name + 1;
+  else if (*name == LUA_SIGNATURE[0])
+    S->name = "binary string";
+  else
+    S->name = name;
+}
+
+
+static const char *noinput (lua_State *L, void *ud, size_t *size) {
+  UNUSED(L); UNUSED(ud);
+  *size = 0;
+  return NULL;
+}
+
+
+/*
+** Set 'z' to read the contents of 'image' from position 'pos' on
+*/
+static void openimage (lua_State *L, ZIO *z, TString *image, size_t pos) {
+  luaZ_init(L, z, noinput, NULL);
+  z->p = getstr(image) + pos;
+  z->n = tsslen(image) - pos;
+}
+
+
+static TString *NewImage (LoadState *S, size_t size) {
+  TString *ts;
+  if (size >= (MAX_SIZE - sizeof(TString))/sizeof(char))
+    error(S, "corrupted");
+  ts = luaS_createlngstrobj(S->L, size);
+  setsvalue2s(S->L, S->L->top, ts);  /* anchor it */
+  luaD_inctop(S->L);
+  return ts;
+}
+
+
 /*
-** load precompiled chunk
+** Decompress a chunk body (see 'Compress' in ldump.c) into a new
+** string
 */
-LClosure *luaU_undump(lua_State *L, ZIO *Z, const char *name) {
+static TString *LoadCompressed (LoadState *S) {
+  size_t size = LoadSize(S);
+  TString *ts = NewImage(S, size);
+  char *out = getstr(ts);
+  size_t n = 0;
+  while (n < size) {
+    size_t len = LoadSize(S);  /* literal run */
+    if (len > size - n)
+      error(S, "corrupted");
+    LoadBlock(S, out + n, len);
+    n += len;
+    if (n < size) {  /* a match follows */
+      size_t dist;
+      len = LoadSize(S);
+      dist = LoadSize(S);
+      if (len > size - n || size - n - len < LUAC_MINMATCH ||
+          dist == 0 || dist > n)
+        error(S, "corrupted");
+      for (len += LUAC_MINMATCH; len > 0; len--, n++)
+        out[n] = out[n - dist];  /* regions may overlap */
+    }
+  }
+  return ts;
+}
+
+
+/*
+** load precompiled chunk; a lazy load keeps the function images in
+** memory, so that nested functions can be decoded later
+*/
+LClosure *luaU_undump(lua_State *L, ZIO *Z, const char *name, int lazy) {
   LoadState S;
   LClosure *cl;
-  if (*name == '@' || *name == '=')
-    S.name = name + 1;
-  else if (*name == LUA_SIGNATURE[0])
-    S.name = "binary string";
-  else
-    S.name = name;
+  TString *image = NULL;
+  ptrdiff_t top = savestack(L, L->top);
+  ZIO z;
+  size_t size;
+  setname(&S, name);
   S.L = L;
   S.Z = Z;
+  S.lazy = lazy;
   checkHeader(&S);
+  switch (LoadByte(&S)) {
+    case LUAC_PLAIN: break;
+    case LUAC_COMPRESSED: {
+      image = LoadCompressed(&S);
+      openimage(L, &z, image, 0);
+      S.Z = &z;
+      break;
+    }
+    default: error(&S, "corrupted");
+  }
   cl = luaF_newLclosure(L, LoadByte(&S));
   setclLvalue(L, L->top, cl);
   luaD_inctop(L);
+  LoadStrings(&S);
   cl->p = luaF_newproto(L);
+  size = LoadSize(&S);
+  if (lazy) {
+    if (image == NULL) {  /* keep (only) the functions' image */
+      image = NewImage(&S, size);
+      LoadBlock(&S, getstr(image), size);
+      openimage(L, &z, image, 0);
+      S.Z = &z;
+    }
+    setsvalue2n(L, &S.strings->array[0], image);
+  }
   LoadFunction(&S, cl->p, NULL);
   lua_assert(cl->nupvalues == cl->p->sizeupvalues);
   luai_verifycode(L, buff, cl->p);
+  L->top = restorestack(L, top);  /* remove auxiliary values */
+  setclLvalue(L, L->top, cl);
+  luaD_inctop(L);
   return cl;
 }
 
+
+/*
+** Decode the 'i'-th nested function of 'f', left unloaded by a lazy
+** load, and put the result in place of its empty prototype
+*/
+Proto *luaU_loadproto (lua_State *L, Proto *f, int i) {
+  LoadState S;
+  ZIO z;
+  Proto *p = f->p[i];
+  LClosure *cl = luaF_newLclosure(L, 0);  /* to anchor the new prototype */
+  lua_assert(luaU_islazy(p));
+  setclLvalue(L, L->top, cl);
+  luaD_inctop(L);
+  cl->p = luaF_newproto(L);
+  setname(&S, (f->source) ? getstr(f->source) : "=?");
+  S.L = L;
+  S.Z = &z;
+  S.strings = p->image;
+  S.nstrings = p->image->sizearray - 1;
+  S.lazy = 1;
+  openimage(L, &z, tsvalue(&p->image->array[0]), p->imageoff);
+  LoadSize(&S);
+  LoadFunction(&S, cl->p, f->source);
+  f->p[i] = cl->p;
+  luaC_objbarrier(L, f, cl->p);
+  L->top--;  /* remove anchor */
+  return f->p[i];
+}
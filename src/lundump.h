@@ -20,13 +20,27 @@
 
 #define MYINT(s)	(s[0]-'0')
 #define LUAC_VERSION	(MYINT(LUA_VERSION_MAJOR)*16+MYINT(LUA_VERSION_MINOR))
-#define LUAC_FORMAT	0	/* this is the official format */
+#define LUAC_FORMAT	3	/* string table and variable-length sizes */
+
+/* how the body of a chunk is stored (byte after the header) */
+#define LUAC_PLAIN	0
+#define LUAC_COMPRESSED	1
+
+/* minimum length of a match in compressed chunks */
+#define LUAC_MINMATCH	4
+
+/* true if prototype 'p' was left unloaded by a lazy load */
+#define luaU_islazy(p)	((p)->image != NULL)
 
 /* load one chunk; from lundump.c */
-LUAI_FUNC LClosure* luaU_undump (lua_State* L, ZIO* Z, const char* name);
+LUAI_FUNC LClosure* luaU_undump (lua_State* L, ZIO* Z, const char* name,
+                                 int lazy);
+
+/* load a function left unloaded by a lazy load; from lundump.c */
+LUAI_FUNC Proto *luaU_loadproto (lua_State *L, Proto *f, int i);
 
 /* dump one chunk; from ldump.c */
 LUAI_FUNC int luaU_dump (lua_State* L, const Proto* f, lua_Writer w,
-                         void* data, int strip);
+                         void* data, int opts);
 
 #endif
@@ -22,12 +22,14 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lobject.h"
 #include "lopcodes.h"
 #include "lstate.h"
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "lundump.h"
 #include "lvm.h"
 
 
@@ -35,6 +37,26 @@
 #define MAXTAGLOOP	2000
 
 
+/* deoptimizations after which an instruction is not quickened again */
+#if !defined(LUAI_MAXDEOPT)
+#define LUAI_MAXDEOPT	4
+#endif
+
+
+/*
+** By default, use jump tables in the main interpreter loop on gcc
+** and compatible compilers (define LUA_USE_JUMPTABLE as 0 to use a
+** 'switch' instead).
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#if defined(__GNUC__)
+#define LUA_USE_JUMPTABLE	1
+#else
+#define LUA_USE_JUMPTABLE	0
+#endif
+#endif
+
+
 
 /*
 ** 'l_intfitsf' checks whether a given integer can be converted to a
@@ -65,6 +87,29 @@
 
 
 
+/*
+** Try to convert string 'obj' to a number. 'luaO_str2num' needs a '\0'
+** after the string, which buffered strings may not have; the byte after
+** one is changed to '\0' during the conversion. (That byte, if in use,
+** belongs to other strings, which nothing reads in the meantime.)
+*/
+static int l_strton (const TValue *obj, TValue *result) {
+  TString *ts = tsvalue(obj);
+  size_t l = vslen(obj);
+  if (!isbuffstr(ts))
+    return (luaO_str2num(getstr(ts), result) == l + 1);
+  else {
+    char *s = getstr(ts);
+    char c = s[l];
+    int res;
+    s[l] = '\0';
+    res = (luaO_str2num(s, result) == l + 1);
+    s[l] = c;
+    return res;
+  }
+}
+
+
 /*
 ** Try to convert a value to a float. The float case is already handled
 ** by the macro 'tonumber'.
@@ -76,7 +121,7 @@ int luaV_tonumber_ (const TValue *obj, lua_Number *n) {
     return 1;
   }
   else if (cvt2num(obj) &&  /* string convertible to number? */
-            luaO_str2num(svalue(obj), &v) == vslen(obj) + 1) {
+            l_strton(obj, &v)) {
     *n = nvalue(&v);  /* convert result of 'luaO_str2num' to a float */
     return 1;
   }
@@ -108,8 +153,7 @@ int luaV_tointeger (const TValue *obj, lua_Integer *p, int mode) {
     *p = ivalue(obj);
     return 1;
   }
-  else if (cvt2num(obj) &&
-            luaO_str2num(svalue(obj), &v) == vslen(obj) + 1) {
+  else if (cvt2num(obj) && l_strton(obj, &v)) {
     obj = &v;
     goto again;  /* convert result from 'luaO_str2num' to an integer */
   }
@@ -152,6 +196,25 @@ static int forlimit (const TValue *obj, lua_Integer *p, lua_Integer step,
 }
 
 
+/*
+** Number of iterations, after the first one, of an integer loop from
+** 'init' to 'limit' (which must run at least once). As the division is
+** done over unsigned values, it cannot overflow, and the loop can
+** then count down without testing the index. A zero step runs forever
+** (2^64 iterations, to be exact).
+*/
+static lua_Unsigned forcount (lua_Integer init, lua_Integer limit,
+                              lua_Integer step) {
+  if (step > 0)
+    return (l_castS2U(limit) - l_castS2U(init)) / l_castS2U(step);
+  else if (step < 0)  /* avoid negating LUA_MININTEGER */
+    return (l_castS2U(init) - l_castS2U(limit)) /
+           (l_castS2U(-(step + 1)) + 1u);
+  else
+    return ~(lua_Unsigned)0;
+}
+
+
 /*
 ** Finish the table access 'val = t[key]'.
 ** if 'slot' is NULL, 't' is not a table; otherwise, 'slot' points to
@@ -198,7 +261,8 @@ void luaV_finishget (lua_State *L, const TValue *t, TValue *key, StkId val,
 ** If 'slot' is NULL, 't' is not a table.  Otherwise, 'slot' points
 ** to the entry 't[key]', or to 'luaO_nilobject' if there is no such
 ** entry.  (The value at 'slot' must be nil, otherwise 'luaV_fastset'
-** would have done the job.)
+** would have done the job, unless 'slot' is an element of a packed
+** array part.)
 */
 void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
                      StkId val, const TValue *slot) {
@@ -207,13 +271,14 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
     const TValue *tm;  /* '__newindex' metamethod */
     if (slot != NULL) {  /* is 't' a table? */
       Table *h = hvalue(t);  /* save 't' table */
-      lua_assert(ttisnil(slot));  /* old value must be nil */
-      tm = fasttm(L, h->metatable, TM_NEWINDEX);  /* get metamethod */
+      if (isscratch(h, slot))  /* element of a packed array part? */
+        tm = NULL;  /* entry exists; no metamethod */
+      else {
+        lua_assert(ttisnil(slot));  /* old value must be nil */
+        tm = fasttm(L, h->metatable, TM_NEWINDEX);  /* get metamethod */
+      }
       if (tm == NULL) {  /* no metamethod? */
-        if (slot == luaO_nilobject)  /* no previous entry? */
-          slot = luaH_newkey(L, h, key);  /* create one */
-        /* no metamethod and (now) there is an entry with given key */
-        setobj2t(L, cast(TValue *, slot), val);  /* set its new value */
+        luaH_finishset(L, h, key, slot, val);  /* set its new value */
         invalidateTMcache(h);
         luaC_barrierback(L, h, val);
         return;
@@ -245,10 +310,10 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
 ** and it uses 'strcoll' (to respect locales) for each segments
 ** of the strings.
 */
-static int l_strcmp (const TString *ls, const TString *rs) {
-  const char *l = getstr(ls);
+static int l_strcmp (lua_State *L, TString *ls, TString *rs) {
+  const char *l = luaS_terminate(L, ls);
   size_t ll = tsslen(ls);
-  const char *r = getstr(rs);
+  const char *r = luaS_terminate(L, rs);
   size_t lr = tsslen(rs);
   for (;;) {  /* for each segment */
     int temp = strcoll(l, r);
@@ -366,7 +431,7 @@ int luaV_lessthan (lua_State *L, const TValue *l, const TValue *r) {
   if (ttisnumber(l) && ttisnumber(r))  /* both operands are numbers? */
     return LTnum(l, r);
   else if (ttisstring(l) && ttisstring(r))  /* both are strings? */
-    return l_strcmp(tsvalue(l), tsvalue(r)) < 0;
+    return l_strcmp(L, tsvalue(l), tsvalue(r)) < 0;
   else if ((res = luaT_callorderTM(L, l, r, TM_LT)) < 0)  /* no metamethod? */
     luaG_ordererror(L, l, r);  /* error */
   return res;
@@ -386,7 +451,7 @@ int luaV_lessequal (lua_State *L, const TValue *l, const TValue *r) {
   if (ttisnumber(l) && ttisnumber(r))  /* both operands are numbers? */
     return LEnum(l, r);
   else if (ttisstring(l) && ttisstring(r))  /* both are strings? */
-    return l_strcmp(tsvalue(l), tsvalue(r)) <= 0;
+    return l_strcmp(L, tsvalue(l), tsvalue(r)) <= 0;
   else if ((res = luaT_callorderTM(L, l, r, TM_LE)) >= 0)  /* try 'le' */
     return res;
   else {  /* try 'lt': */
@@ -456,12 +521,34 @@ int luaV_equalobj (lua_State *L, const TValue *t1, const TValue *t2) {
 
 #define isemptystr(o)	(ttisshrstring(o) && tsvalue(o)->shrlen == 0)
 
-/* copy strings in stack from top - n up to top - 1 to buffer */
-static void copy2buff (StkId top, int n, char *buff) {
+/*
+** Space for the numbers converted by one pass of 'luaV_concat'. Their
+** texts are written there, not interned; a pass stops early if it has
+** no space for another number.
+*/
+#define CONCATNUMBUFF	(4 * MAXNUMBER2STR)
+
+/*
+** Copy values in stack from top - n up to top - 1 to buffer. Numbers
+** were already converted, in the same order, to texts starting at
+** 'nums', each one ended by a '\0'.
+*/
+static void copy2buff (StkId top, int n, char *buff, const char *nums) {
   size_t tl = 0;  /* size already copied */
   do {
-    size_t l = vslen(top - n);  /* length of string being copied */
-    memcpy(buff + tl, svalue(top - n), l * sizeof(char));
+    StkId o = top - n;
+    const char *s;
+    size_t l;  /* length of string being copied */
+    if (ttisstring(o)) {
+      s = svalue(o);
+      l = vslen(o);
+    }
+    else {  /* converted number */
+      s = nums;
+      l = strlen(nums);
+      nums += l + 1;
+    }
+    memcpy(buff + tl, s, l * sizeof(char));
     tl += l;
   } while (--n > 0);
 }
@@ -469,39 +556,62 @@ static void copy2buff (StkId top, int n, char *buff) {
 
 /*
 ** Main operation for concatenation: concat 'total' values in the stack,
-** from 'L->top - total' up to 'L->top - 1'.
+** from 'L->top - total' up to 'L->top - 1'. Each pass builds the result
+** of as many strings and numbers as it can directly in the final string,
+** without intermediate strings.
 */
 void luaV_concat (lua_State *L, int total) {
   lua_assert(total >= 2);
   do {
     StkId top = L->top;
     int n = 2;  /* number of elements handled in this pass (at least 2) */
-    if (!(ttisstring(top-2) || cvt2str(top-2)) || !tostring(L, top-1))
+    if (!(ttisstring(top-2) || cvt2str(top-2)) ||
+        !(ttisstring(top-1) || cvt2str(top-1)))
       luaT_trybinTM(L, top-2, top-1, top-2, TM_CONCAT);
     else if (isemptystr(top - 1))  /* second operand is empty? */
       cast_void(tostring(L, top - 2));  /* result is first operand */
     else if (isemptystr(top - 2)) {  /* first operand is an empty string? */
+      cast_void(tostring(L, top - 1));
       setobjs2s(L, top - 2, top - 1);  /* result is second op. */
     }
     else {
-      /* at least two non-empty string values; get as many as possible */
-      size_t tl = vslen(top - 1);
+      /* at least two non-empty values; get as many as possible */
+      char nbuff[CONCATNUMBUFF];
+      char *nums = nbuff + CONCATNUMBUFF;  /* filled backwards */
+      size_t tl = 0;
       TString *ts;
-      /* collect total length and number of strings */
-      for (n = 1; n < total && tostring(L, top - n - 1); n++) {
-        size_t l = vslen(top - n - 1);
+      /* collect total length and number of values */
+      for (n = 0; n < total; n++) {
+        StkId o = top - n - 1;
+        size_t l;
+        if (ttisstring(o))
+          l = vslen(o);
+        else if (cvt2str(o) && nums - nbuff >= MAXNUMBER2STR) {
+          char temp[MAXNUMBER2STR];
+          l = luaO_tostringbuff(o, temp);
+          nums -= l + 1;
+          memcpy(nums, temp, l * sizeof(char));
+          nums[l] = '\0';
+        }
+        else break;
         if (l >= (MAX_SIZE/sizeof(char)) - tl)
           luaG_runerror(L, "string length overflow");
         tl += l;
       }
+      lua_assert(n >= 2);
       if (tl <= LUAI_MAXSHORTLEN) {  /* is result a short string? */
         char buff[LUAI_MAXSHORTLEN];
-        copy2buff(top, n, buff);  /* copy strings to buffer */
+        copy2buff(top, n, buff, nums);  /* copy values to buffer */
         ts = luaS_newlstr(L, buff, tl);
       }
-      else {  /* long string; copy strings directly to final result */
-        ts = luaS_createlngstrobj(L, tl);
-        copy2buff(top, n, getstr(ts));
+      else {  /* long string; copy values directly to final result */
+        StkId first = top - n;
+        ts = ttisstring(first) ? luaS_newconcat(L, tsvalue(first), tl)
+                               : luaS_createlngstrobj(L, tl);
+        if (ttisstring(first) && getstr(ts) == svalue(first))  /* in place? */
+          copy2buff(top, n - 1, getstr(ts) + vslen(first), nums);
+        else
+          copy2buff(top, n, getstr(ts), nums);
       }
       setsvalue2s(L, top - n, ts);  /* create result */
     }
@@ -603,23 +713,28 @@ lua_Integer luaV_shiftl (lua_Integer x, lua_Integer y) {
 
 
 /*
-** check whether cached closure in prototype 'p' may be reused, that is,
-** whether there is a cached closure with the same upvalues needed by
-** new closure to be created.
+** check whether a cached closure in prototype 'p' may be reused, that
+** is, whether there is a cached closure with the same upvalues needed
+** by new closure to be created.
 */
 static LClosure *getcached (Proto *p, UpVal **encup, StkId base) {
-  LClosure *c = p->cache;
-  if (c != NULL) {  /* is there a cached closure? */
-    int nup = p->sizeupvalues;
-    Upvaldesc *uv = p->upvalues;
+  int nup = p->sizeupvalues;
+  Upvaldesc *uv = p->upvalues;
+  int n;
+  for (n = 0; n < LUAI_NCLCACHE; n++) {
+    LClosure *c = p->cache[n];
     int i;
+    if (c == NULL)  /* empty (or collected) entry? */
+      continue;
     for (i = 0; i < nup; i++) {  /* check whether it has right upvalues */
       TValue *v = uv[i].instack ? base + uv[i].idx : encup[uv[i].idx]->v;
       if (c->upvals[i]->v != v)
-        return NULL;  /* wrong upvalue; cannot reuse closure */
+        break;  /* wrong upvalue; cannot reuse closure */
     }
+    if (i == nup)
+      return c;  /* return cached closure */
   }
-  return c;  /* return cached closure (or NULL if no cached closure) */
+  return NULL;  /* no cached closure may be reused */
 }
 
 
@@ -645,8 +760,11 @@ static void pushclosure (lua_State *L, Proto *p, UpVal **encup, StkId base,
     ncl->upvals[i]->refcount++;
     /* new closure is white, so we do not need a barrier here */
   }
-  if (!isblack(p))  /* cache will not break GC invariant? */
-    p->cache = ncl;  /* save it on cache for reuse */
+  if (!isblack(p)) {  /* cache will not break GC invariant? */
+    for (i = LUAI_NCLCACHE - 1; i > 0; i--)  /* drop the oldest entry */
+      p->cache[i] = p->cache[i - 1];
+    p->cache[0] = ncl;  /* save it on cache for reuse */
+  }
 }
 
 
@@ -657,7 +775,7 @@ void luaV_finishOp (lua_State *L) {
   CallInfo *ci = L->ci;
   StkId base = ci->u.l.base;
   Instruction inst = *(ci->u.l.savedpc - 1);  /* interrupted instruction */
-  OpCode op = GET_OPCODE(inst);
+  OpCode op = genericop(GET_OPCODE(inst));
   switch (op) {  /* finish its execution */
     case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_IDIV:
     case OP_BAND: case OP_BOR: case OP_BXOR: case OP_SHL: case OP_SHR:
@@ -738,7 +856,8 @@ void luaV_finishOp (lua_State *L) {
 #define dojump(ci,i,e) \
   { int a = GETARG_A(i); \
     if (a != 0) luaF_close(L, ci->u.l.base + a - 1); \
-    ci->u.l.savedpc += GETARG_sBx(i) + e; }
+    ci->u.l.savedpc += GETARG_sBx(i) + e; \
+    if (GETARG_sBx(i) < 0) jitcheck(); }
 
 /* for test instructions, execute the jump instruction that follows it */
 #define donextjump(ci)	{ i = *ci->u.l.savedpc; dojump(ci, i, 1); }
@@ -755,7 +874,7 @@ void luaV_finishOp (lua_State *L) {
 /* fetch an instruction and prepare its execution */
 #define vmfetch()	{ \
   i = *(ci->u.l.savedpc++); \
-  if (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) \
+  if (L->hookmask & MASKTRACE) \
     Protect(luaG_traceexec(L)); \
   ra = RA(i); /* WARNING: any stack reallocation invalidates 'ra' */ \
   lua_assert(base == ci->u.l.base); \
@@ -772,13 +891,98 @@ void luaV_finishOp (lua_State *L) {
 ** metamethod (which can reallocate the stack)
 */
 #define gettableProtected(L,t,k,v)  { const TValue *slot; \
-  if (luaV_fastget(L,t,k,slot,luaH_get)) { setobj2s(L, v, slot); } \
+  if (luaV_fastgetpacked(t,k,v)) { } \
+  else if (luaV_fastget(L,t,k,slot,luaH_get)) { setobj2s(L, v, slot); } \
   else Protect(luaV_finishget(L,t,k,v,slot)); }
 
 
+/*
+** 'gettableProtected' with an inline cache, for short-string keys:
+** each instruction keeps in 'icache' the index of the node where it
+** last found its key, and tries that node first. The cache needs no
+** invalidation: a hit checks that the node still holds the key.
+*/
+#define gettableCached(L,t,k,v) { const TValue *slot; \
+  if (ttistable(t) && ttisshrstring(k)) { \
+    Table *h = hvalue(t); \
+    unsigned int *hint = &cl->p->icache[ci->u.l.savedpc - cl->p->code - 1]; \
+    if (*hint < cast(unsigned int, sizenode(h)) && \
+        ttisshrstring(gkey(gnode(h, *hint))) && \
+        eqshrstr(tsvalue(gkey(gnode(h, *hint))), tsvalue(k))) \
+      slot = gval(gnode(h, *hint));  /* hit */ \
+    else \
+      slot = luaH_getshortstrhint(h, tsvalue(k), hint); \
+    if (!ttisnil(slot)) { setobj2s(L, v, slot); } \
+    else Protect(luaV_finishget(L,t,k,v,slot)); \
+  } \
+  else gettableProtected(L,t,k,v); }
+
+
+/*
+** Quickening: an OP_ADD, OP_SUB or OP_MUL that finds two integer (or
+** two float) operands is rewritten in place into a variant that only
+** handles that case, and that rewrites it back ("deoptimizes") when it
+** finds other operands. The 'icache' entry of an arithmetic instruction
+** counts its deoptimizations; after LUAI_MAXDEOPT of them, it is not
+** quickened again.
+*/
+#define quicken(op) \
+  { Instruction *pc = cast(Instruction *, ci->u.l.savedpc - 1); \
+    if (cl->p->icache[pc - cl->p->code] < LUAI_MAXDEOPT) \
+      SET_OPCODE(*pc, op); }
+
+#define deoptimize(op) \
+  { Instruction *pc = cast(Instruction *, ci->u.l.savedpc - 1); \
+    cl->p->icache[pc - cl->p->code]++; \
+    SET_OPCODE(*pc, op); }
+
+/*
+** end of a superinstruction: fetch its second instruction, which must
+** be an 'op', and go straight to the code at 'target' that executes it (unless
+** hooks need to see that instruction)
+*/
+#define vmfuse(op,target) { \
+  if (L->hookmask & MASKTRACE) { vmbreak; } \
+  i = *(ci->u.l.savedpc++); \
+  ra = RA(i); \
+  lua_assert(GET_OPCODE(i) == op); \
+  goto target; }
+
+/*
+** run native code of a hot function from its current instruction,
+** compiling it when it gets hot (see ljit.c)
+*/
+#if LUA_USE_JIT
+#define jitcheck() \
+  { if (cl->p->jit != NULL || \
+        (--cl->p->jitcount == 0 && luaJ_compile(L, cl->p))) \
+      Protect(luaJ_execute(L, ci)); }
+#else
+#define jitcheck()	((void)0)
+#endif
+
+/* generic arithmetic that quickens its instruction */
+#define arithquick(L,iop,fop,tm,opint,opflt) { \
+  TValue *rb = RKB(i); \
+  TValue *rc = RKC(i); \
+  lua_Number nb; lua_Number nc; \
+  if (ttisinteger(rb) && ttisinteger(rc)) { \
+    lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc); \
+    setivalue(ra, intop(iop, ib, ic)); \
+    quicken(opint); \
+  } \
+  else if (tonumber(rb, &nb) && tonumber(rc, &nc)) { \
+    if (ttisfloat(rb) && ttisfloat(rc)) \
+      quicken(opflt); \
+    setfltvalue(ra, fop(L, nb, nc)); \
+  } \
+  else { Protect(luaT_trybinTM(L, rb, rc, ra, tm)); } }
+
+
 /* same for 'luaV_settable' */
 #define settableProtected(L,t,k,v) { const TValue *slot; \
-  if (!luaV_fastset(L,t,k,slot,luaH_get,v)) \
+  if (luaV_fastsetpacked(t,k,v)) { } \
+  else if (!luaV_fastset(L,t,k,slot,luaH_get,v)) \
     Protect(luaV_finishset(L,t,k,v,slot)); }
 
 
@@ -788,12 +992,16 @@ void luaV_execute (lua_State *L) {
   LClosure *cl;
   TValue *k;
   StkId base;
+#if LUA_USE_JUMPTABLE
+#include "ljumptab.h"
+#endif
   ci->callstatus |= CIST_FRESH;  /* fresh invocation of 'luaV_execute" */
  newframe:  /* reentry point when frame changes (call/return) */
   lua_assert(ci == L->ci);
   cl = clLvalue(ci->func);  /* local reference to function's closure */
   k = cl->p->k;  /* local reference to function's constant table */
   base = ci->u.l.base;  /* local copy of function's base */
+  jitcheck();
   /* main loop of interpreter */
   for (;;) {
     Instruction i;
@@ -836,15 +1044,16 @@ void luaV_execute (lua_State *L) {
       vmcase(OP_GETTABUP) {
         TValue *upval = cl->upvals[GETARG_B(i)]->v;
         TValue *rc = RKC(i);
-        gettableProtected(L, upval, rc, ra);
+        gettableCached(L, upval, rc, ra);
         vmbreak;
       }
       vmcase(OP_GETTABLE) {
+       l_gettable: {
         StkId rb = RB(i);
         TValue *rc = RKC(i);
-        gettableProtected(L, rb, rc, ra);
+        gettableCached(L, rb, rc, ra);
         vmbreak;
-      }
+      }}
       vmcase(OP_SETTABUP) {
         TValue *upval = cl->upvals[GETARG_A(i)]->v;
         TValue *rb = RKB(i);
@@ -875,57 +1084,22 @@ void luaV_execute (lua_State *L) {
         vmbreak;
       }
       vmcase(OP_SELF) {
-        const TValue *aux;
         StkId rb = RB(i);
         TValue *rc = RKC(i);
-        TString *key = tsvalue(rc);  /* key must be a string */
         setobjs2s(L, ra + 1, rb);
-        if (luaV_fastget(L, rb, key, aux, luaH_getstr)) {
-          setobj2s(L, ra, aux);
-        }
-        else Protect(luaV_finishget(L, rb, rc, ra, aux));
+        gettableCached(L, rb, rc, ra);
         vmbreak;
       }
       vmcase(OP_ADD) {
-        TValue *rb = RKB(i);
-        TValue *rc = RKC(i);
-        lua_Number nb; lua_Number nc;
-        if (ttisinteger(rb) && ttisinteger(rc)) {
-          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
-          setivalue(ra, intop(+, ib, ic));
-        }
-        else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
-          setfltvalue(ra, luai_numadd(L, nb, nc));
-        }
-        else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_ADD)); }
+        arithquick(L, +, luai_numadd, TM_ADD, OP_ADDINT, OP_ADDFLT);
         vmbreak;
       }
       vmcase(OP_SUB) {
-        TValue *rb = RKB(i);
-        TValue *rc = RKC(i);
-        lua_Number nb; lua_Number nc;
-        if (ttisinteger(rb) && ttisinteger(rc)) {
-          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
-          setivalue(ra, intop(-, ib, ic));
-        }
-        else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
-          setfltvalue(ra, luai_numsub(L, nb, nc));
-        }
-        else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_SUB)); }
+        arithquick(L, -, luai_numsub, TM_SUB, OP_SUBINT, OP_SUBFLT);
         vmbreak;
       }
       vmcase(OP_MUL) {
-        TValue *rb = RKB(i);
-        TValue *rc = RKC(i);
-        lua_Number nb; lua_Number nc;
-        if (ttisinteger(rb) && ttisinteger(rc)) {
-          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
-          setivalue(ra, intop(*, ib, ic));
-        }
-        else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
-          setfltvalue(ra, luai_nummul(L, nb, nc));
-        }
-        else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_MUL)); }
+        arithquick(L, *, luai_nummul, TM_MUL, OP_MULINT, OP_MULFLT);
         vmbreak;
       }
       vmcase(OP_DIV) {  /* float division (always with floats) */
@@ -1128,6 +1302,7 @@ void luaV_execute (lua_State *L) {
         vmbreak;
       }
       vmcase(OP_CALL) {
+       l_call: {
         int b = GETARG_B(i);
         int nresults = GETARG_C(i) - 1;
         if (b != 0) L->top = ra+b;  /* else previous instruction set top */
@@ -1141,12 +1316,18 @@ void luaV_execute (lua_State *L) {
           goto newframe;  /* restart luaV_execute over new Lua function */
         }
         vmbreak;
-      }
+      }}
       vmcase(OP_TAILCALL) {
         int b = GETARG_B(i);
         if (b != 0) L->top = ra+b;  /* else previous instruction set top */
         lua_assert(GETARG_C(i) - 1 == LUA_MULTRET);
-        if (luaD_precall(L, ra, LUA_MULTRET)) {  /* C function? */
+        if (ttisLclosure(ra) && !(L->hookmask & LUA_MASKCALL)) {
+          /* Lua function: reuse current frame in place */
+          if (cl->p->sizep > 0) luaF_close(L, base);
+          luaD_pretailcall(L, ci, ra, cast_int(L->top - ra) - 1);
+          goto newframe;  /* restart luaV_execute over new Lua function */
+        }
+        else if (luaD_precall(L, ra, LUA_MULTRET)) {  /* C function? */
           Protect((void)0);  /* update 'base' */
         }
         else {
@@ -1189,13 +1370,14 @@ void luaV_execute (lua_State *L) {
       }
       vmcase(OP_FORLOOP) {
         if (ttisinteger(ra)) {  /* integer loop? */
-          lua_Integer step = ivalue(ra + 2);
-          lua_Integer idx = intop(+, ivalue(ra), step); /* increment index */
-          lua_Integer limit = ivalue(ra + 1);
-          if ((0 < step) ? (idx <= limit) : (limit <= idx)) {
+          lua_Unsigned count = l_castS2U(ivalue(ra + 1));
+          if (count > 0) {  /* still more iterations? */
+            lua_Integer idx = intop(+, ivalue(ra), ivalue(ra + 2));
+            chgivalue(ra + 1, l_castU2S(count - 1));  /* update counter */
             ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
             chgivalue(ra, idx);  /* update internal index... */
             setivalue(ra + 3, idx);  /* ...and external index */
+            jitcheck();
           }
         }
         else {  /* floating loop */
@@ -1207,6 +1389,7 @@ void luaV_execute (lua_State *L) {
             ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
             chgfltvalue(ra, idx);  /* update internal index... */
             setfltvalue(ra + 3, idx);  /* ...and external index */
+            jitcheck();
           }
         }
         vmbreak;
@@ -1220,9 +1403,14 @@ void luaV_execute (lua_State *L) {
         if (ttisinteger(init) && ttisinteger(pstep) &&
             forlimit(plimit, &ilimit, ivalue(pstep), &stopnow)) {
           /* all values are integer */
-          lua_Integer initv = (stopnow ? 0 : ivalue(init));
-          setivalue(plimit, ilimit);
-          setivalue(init, intop(-, initv, ivalue(pstep)));
+          lua_Integer initv = ivalue(init);
+          lua_Integer step = ivalue(pstep);
+          if (stopnow || (0 < step ? initv > ilimit : initv < ilimit))
+            ci->u.l.savedpc += GETARG_sBx(i) + 1;  /* skip the loop */
+          else {  /* prepare first iteration, which follows this one */
+            setivalue(plimit, l_castU2S(forcount(initv, ilimit, step)));
+            setivalue(ra + 3, initv);  /* external index */
+          }
         }
         else {  /* try making all values floats */
           lua_Number ninit; lua_Number nlimit; lua_Number nstep;
@@ -1235,8 +1423,8 @@ void luaV_execute (lua_State *L) {
           if (!tonumber(init, &ninit))
             luaG_runerror(L, "'for' initial value must be a number");
           setfltvalue(init, luai_numsub(L, ninit, nstep));
+          ci->u.l.savedpc += GETARG_sBx(i);  /* go test the first iteration */
         }
-        ci->u.l.savedpc += GETARG_sBx(i);
         vmbreak;
       }
       vmcase(OP_TFORCALL) {
@@ -1257,6 +1445,7 @@ void luaV_execute (lua_State *L) {
         if (!ttisnil(ra + 1)) {  /* continue loop? */
           setobjs2s(L, ra, ra + 1);  /* save control variable */
            ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
+           jitcheck();
         }
         vmbreak;
       }
@@ -1284,7 +1473,12 @@ void luaV_execute (lua_State *L) {
       }
       vmcase(OP_CLOSURE) {
         Proto *p = cl->p->p[GETARG_Bx(i)];
-        LClosure *ncl = getcached(p, cl->upvals, base);  /* cached closure */
+        LClosure *ncl;
+        if (luaU_islazy(p)) {  /* not loaded yet? */
+          Protect(p = luaU_loadproto(L, cl->p, GETARG_Bx(i)));
+          ra = RA(i);
+        }
+        ncl = getcached(p, cl->upvals, base);  /* cached closure */
         if (ncl == NULL)  /* no match? */
           pushclosure(L, p, cl->upvals, base, ra);  /* create a new one */
         else
@@ -1314,6 +1508,99 @@ void luaV_execute (lua_State *L) {
         lua_assert(0);
         vmbreak;
       }
+      vmcase(OP_ADDINT) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
+          setivalue(ra, intop(+, ib, ic));
+        }
+        else {
+          deoptimize(OP_ADD);
+          arithquick(L, +, luai_numadd, TM_ADD, OP_ADDINT, OP_ADDFLT);
+        }
+        vmbreak;
+      }
+      vmcase(OP_ADDFLT) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numadd(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else {
+          deoptimize(OP_ADD);
+          arithquick(L, +, luai_numadd, TM_ADD, OP_ADDINT, OP_ADDFLT);
+        }
+        vmbreak;
+      }
+      vmcase(OP_SUBINT) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
+          setivalue(ra, intop(-, ib, ic));
+        }
+        else {
+          deoptimize(OP_SUB);
+          arithquick(L, -, luai_numsub, TM_SUB, OP_SUBINT, OP_SUBFLT);
+        }
+        vmbreak;
+      }
+      vmcase(OP_SUBFLT) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numsub(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else {
+          deoptimize(OP_SUB);
+          arithquick(L, -, luai_numsub, TM_SUB, OP_SUBINT, OP_SUBFLT);
+        }
+        vmbreak;
+      }
+      vmcase(OP_MULINT) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
+          setivalue(ra, intop(*, ib, ic));
+        }
+        else {
+          deoptimize(OP_MUL);
+          arithquick(L, *, luai_nummul, TM_MUL, OP_MULINT, OP_MULFLT);
+        }
+        vmbreak;
+      }
+      vmcase(OP_MULFLT) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_nummul(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else {
+          deoptimize(OP_MUL);
+          arithquick(L, *, luai_nummul, TM_MUL, OP_MULINT, OP_MULFLT);
+        }
+        vmbreak;
+      }
+      vmcase(OP_GETTABUPCALL) {
+        TValue *upval = cl->upvals[GETARG_B(i)]->v;
+        TValue *rc = RKC(i);
+        gettableCached(L, upval, rc, ra);
+        vmfuse(OP_CALL, l_call);
+      }
+      vmcase(OP_GETTABUPGET) {
+        TValue *upval = cl->upvals[GETARG_B(i)]->v;
+        TValue *rc = RKC(i);
+        gettableCached(L, upval, rc, ra);
+        vmfuse(OP_GETTABLE, l_gettable);
+      }
+      vmcase(OP_GETTABLEGET) {
+        StkId rb = RB(i);
+        TValue *rc = RKC(i);
+        gettableCached(L, rb, rc, ra);
+        vmfuse(OP_GETTABLE, l_gettable);
+      }
     }
   }
 }
@@ -61,34 +61,67 @@
    : (slot = f(hvalue(t), k),  /* else, do raw access */  \
       !ttisnil(slot)))  /* result not nil? */
 
+/*
+** fast track for an element of the packed array part of a table: if
+** 't' is a table and integer 'n' is the index of an element of its
+** packed array part, copy 't[n]' to 'v' and return 1 (without going
+** through the scratch value of 'luaH_getint'); otherwise, return 0.
+*/
+#define luaV_getpacked(t,n,v) \
+  (ttistable(t) && l_castS2U(n) - 1 < hvalue(t)->npacked \
+   ? (val_(v) = packedvalues(hvalue(t))[(n) - 1], \
+      settt_(v, hvalue(t)->arraytype), 1) \
+   : 0)
+
+#define luaV_fastgetpacked(t,k,v) \
+  (ttisinteger(k) && luaV_getpacked(t, ivalue(k), v))
+
 /*
 ** standard implementation for 'gettable'
 */
 #define luaV_gettable(L,t,k,v) { const TValue *slot; \
-  if (luaV_fastget(L,t,k,slot,luaH_get)) { setobj2s(L, v, slot); } \
+  if (luaV_fastgetpacked(t,k,v)) { } \
+  else if (luaV_fastget(L,t,k,slot,luaH_get)) { setobj2s(L, v, slot); } \
   else luaV_finishget(L,t,k,v,slot); }
 
 
 /*
 ** Fast track for set table. If 't' is a table and 't[k]' is not nil,
 ** call GC barrier, do a raw 't[k]=v', and return true; otherwise,
-** return false with 'slot' equal to NULL (if 't' is not a table) or
-** 'nil'. (This is needed by 'luaV_finishget'.) Note that, if the macro
-** returns true, there is no need to 'invalidateTMcache', because the
-** call is not creating a new entry.
+** return false with 'slot' equal to NULL (if 't' is not a table),
+** 'nil', or the scratch value of a packed array part (which must be
+** written through 'luaH_finishset'). (This is needed by
+** 'luaV_finishget'.) Note that, if the macro returns true, there is no
+** need to 'invalidateTMcache', because the call is not creating a new
+** entry.
 */
 #define luaV_fastset(L,t,k,slot,f,v) \
   (!ttistable(t) \
    ? (slot = NULL, 0) \
    : (slot = f(hvalue(t), k), \
-     ttisnil(slot) ? 0 \
+     ttisnil(slot) || isscratch(hvalue(t), slot) ? 0 \
      : (luaC_barrierback(L, hvalue(t), v), \
         setobj2t(L, cast(TValue *,slot), v), \
         1)))
 
 
+/*
+** fast track for replacing an element of the packed array part of a
+** table by a value of the same type (a number, so no barrier is needed)
+*/
+#define luaV_setpacked(t,n,v) \
+  (ttistable(t) && l_castS2U(n) - 1 < hvalue(t)->npacked && \
+   rttype(v) == hvalue(t)->arraytype \
+   ? (packedvalues(hvalue(t))[(n) - 1] = val_(v), 1) \
+   : 0)
+
+#define luaV_fastsetpacked(t,k,v) \
+  (ttisinteger(k) && luaV_setpacked(t, ivalue(k), v))
+
+
 #define luaV_settable(L,t,k,v) { const TValue *slot; \
-  if (!luaV_fastset(L,t,k,slot,luaH_get,v)) \
+  if (luaV_fastsetpacked(t,k,v)) { } \
+  else if (!luaV_fastset(L,t,k,slot,luaH_get,v)) \
     luaV_finishset(L,t,k,v,slot); }
 
 
@@ -0,0 +1,7 @@
+do
+    local x = 1
+    goto l
+    local x = 2
+    ::l::
+    print(x)
+end
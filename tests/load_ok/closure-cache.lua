@@ -0,0 +1,23 @@
+local function maker (k)
+    return function () return function () return k end end
+end
+local fa, fb = maker("a"), maker("b")
+local a1, b1, a2, b2 = fa(), fb(), fa(), fb()
+assert(a1 == a2 and b1 == b2 and a1 ~= b1,
+       [[Closures with the same upvalues are reused, even when alternated.]])
+assert(a1() == "a" and b1() == "b", [[Reused closures keep their own upvalues.]])
+
+
+local fs = {}
+for i = 1, 3 do fs[i] = function () return i end end
+assert(fs[1] ~= fs[2] and fs[1]() == 1 and fs[2]() == 2 and fs[3]() == 3,
+       [[Closures over different loop variables are not reused.]])
+
+
+local makers = {}
+for i = 1, 10 do makers[i] = maker(i) end
+local first = makers[1]()
+for i = 2, 10 do makers[i]() end
+local again = makers[1]()
+assert(again ~= first and again() == 1 and first() == 1,
+       [[Closures evicted from the cache are created again.]])
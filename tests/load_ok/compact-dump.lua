@@ -0,0 +1,29 @@
+local function chunk ()
+    local names = {}
+    for i = 1, 20 do
+        names[i] = function () return "a repeated string constant" .. i end
+    end
+    return names
+end
+
+
+local plain, compressed = string.dump(chunk), string.dump(chunk, false, true)
+assert(#compressed < #plain, [[Compressed dumps are smaller.]])
+
+
+for _, image in ipairs{plain, compressed, string.dump(chunk, true, true)} do
+    for _, mode in ipairs{"b", "bl"} do
+        local names = load(image, "compact", mode)()
+        assert(names[20]() == "a repeated string constant20",
+               [[Compressed and stripped dumps load in all modes.]])
+    end
+end
+
+
+assert(string.dump(load(compressed, "compact", "b")) == plain,
+       [[Loading a compressed dump gives back the same function.]])
+
+
+local tiny = function () end
+assert(#string.dump(tiny, false, true) <= #string.dump(tiny),
+       [[Dumps are only compressed when that makes them smaller.]])
@@ -0,0 +1,22 @@
+local i, f = 42, 0.5
+assert("a" .. i .. "," .. f .. "," .. -i == "a42,0.5,-42",
+       [[Concatenation converts numbers in a chain.]])
+
+assert(1 .. 2 == "12" and 3.0 .. "" == "3.0" and "" .. 3 == "3",
+       [[Concatenation of numbers always gives strings.]])
+
+assert(math.mininteger .. "|" .. 2^63 .. "|" .. -0.0
+       == tostring(math.mininteger) .. "|" .. tostring(2^63) .. "|" .. tostring(-0.0),
+       [[Numbers are concatenated with the same text as tostring.]])
+
+
+local long = string.rep("x", 50)
+local s = long .. 1 .. 2 .. 3 .. 4 .. 5 .. 6 .. 7 .. 8 .. 9 .. 10 .. 1.25 .. long
+assert(#s == 115 and s:sub(51, 65) == "123456789101.25",
+       [[Chains with many numbers build long strings.]])
+
+
+local o = setmetatable({}, {__concat = function (a, b)
+    return (type(a) == "table" and "T" or a) .. (type(b) == "table" and "T" or b)
+end})
+assert(1 .. 2 .. o .. 3 .. 4 == "12T34", [[Chains call __concat for tables.]])
@@ -0,0 +1,65 @@
+local function count (a, b, c)
+    local n, last = 0, nil
+    for i = a, b, c do n = n + 1; last = i end
+    return n, last
+end
+
+
+local n, last = count(1, 10, 1)
+assert(n == 10 and last == 10, [[Integer loops run from the start to the limit.]])
+
+n, last = count(1, 10, 3)
+assert(n == 4 and last == 10, [[Integer loops stop at the last index within the limit.]])
+
+n, last = count(10, 1, -4)
+assert(n == 3 and last == 2, [[Integer loops can count down.]])
+
+n = count(5, 1, 1)
+assert(n == 0, [[Integer loops with the start past the limit do not run.]])
+
+
+n, last = count(math.maxinteger - 2, math.maxinteger, 1)
+assert(n == 3 and last == math.maxinteger,
+       [[Integer loops up to the largest integer do not overflow.]])
+
+n, last = count(math.mininteger + 2, math.mininteger, -1)
+assert(n == 3 and last == math.mininteger,
+       [[Integer loops down to the smallest integer do not overflow.]])
+
+n, last = count(math.mininteger, math.maxinteger, math.maxinteger)
+assert(n == 3 and last == math.maxinteger - 1,
+       [[Integer loops with huge steps do not overflow.]])
+
+n, last = count(math.maxinteger, math.mininteger, math.mininteger)
+assert(n == 2 and last == -1, [[Integer loops with the smallest step do not overflow.]])
+
+
+n, last = count(1, 3.5, 1)
+assert(n == 3 and math.type(last) == "integer",
+       [[Integer loops round float limits.]])
+
+n = count(1, -math.huge, 1)
+assert(n == 0, [[Integer loops with a limit below all integers do not run.]])
+
+n = count(math.mininteger, -1e100, 1)
+assert(n == 0, [[Integer loops from the smallest integer respect huge limits.]])
+
+n, last = count(1, 3, 0.5)
+assert(n == 5 and last == 3.0, [[Float loops still work.]])
+
+
+local s = 0
+for i = 1, 3 do
+    i = i * 10
+    s = s + i
+end
+assert(s == 60, [[Assigning to the loop variable does not change the loop.]])
+
+
+local k = 0
+for i = 5, 1, 0 do
+    k = k + 1
+    if k == 100 then break end
+end
+assert(k == 100 and count(1, 5, 0) == 0,
+       [[Integer loops with a zero step run forever or not at all.]])
@@ -0,0 +1,24 @@
+local function getx (t) return t.x end
+
+
+local a, b = {x = 1}, {y = 0, x = 2}
+assert(getx(a) == 1 and getx(b) == 2 and getx(a) == 1,
+       [[A cached field access works on different tables.]])
+
+
+for i = 1, 100 do a["k" .. i] = i end
+assert(getx(a) == 1, [[Cached field accesses survive a rehash.]])
+
+
+a.x = nil
+assert(getx(a) == nil, [[Cached field accesses see removed keys.]])
+
+
+setmetatable(a, {__index = function (_, k) return k .. "!" end})
+assert(getx(a) == "x!", [[Cached field accesses still call __index.]])
+
+
+local obj = {n = 0}
+function obj:inc () self.n = self.n + 1 return self end
+for _ = 1, 10 do obj:inc() end
+assert(obj.n == 10, [[Cached method lookups work.]])
@@ -0,0 +1,90 @@
+local calls = 0
+local function count ()
+    if debug.getinfo(2, "S").what == "Lua" then calls = calls + 1 end
+end
+
+
+local function id (x) return x end
+debug.sethook(count, "c")
+local v = id(3)
+debug.sethook()
+assert(v == 3 and calls == 0, [[Calls to small local functions are expanded inline.]])
+
+
+local function second (a, b) return b end
+assert(second(1) == nil and second() == nil and second(1, 2, 3) == 2,
+       [[Inlined calls adjust arguments like regular calls.]])
+
+
+local function two (a) return a, not a end
+local x, y, z = two(1)
+assert(x == 1 and y == false and z == nil,
+       [[Inlined calls adjust results like regular calls.]])
+
+
+local k = 10
+local function getk () return k end
+k = 20
+assert(getk() == 20, [[Inlined calls see the current value of upvalues.]])
+
+
+local last
+local function set (v) last = v end
+set(1); set(2)
+assert(last == 2, [[Inlined calls can assign to upvalues.]])
+
+
+local function choose (c, a, b) return c and a or b end
+local function isnil (v) return v == nil end
+local m = 0
+for i = 1, 10 do
+    if isnil(i) then m = -1 else m = choose(i % 2 == 0, i, m) end
+end
+assert(m == 10, [[Inlined calls keep jumps around them correct.]])
+
+
+local function pair (a, b) return {a, b} end
+local p = pair(1, 2)
+assert(p[1] == 1 and p[2] == 2 and #p == 2, [[Inlined calls can build tables.]])
+
+
+local function one () return 1 end
+local r = {}
+for i = 1, 2 do
+    r[i] = one()
+    one = function () return 2 end
+end
+assert(r[1] == 1 and r[2] == 2, [[Reassigned local functions are not inlined.]])
+
+
+local function five () return 5 end
+local s = {}
+for i = 1, 2 do
+    s[i] = five();
+    (function () five = function () return 6 end end)()
+end
+assert(s[1] == 5 and s[2] == 6, [[Captured local functions are not inlined.]])
+
+
+local function fact (n) if n <= 1 then return 1 end return n * fact(n - 1) end
+assert(fact(5) == 120, [[Recursive local functions are not inlined.]])
+
+
+local function where () return debug.getinfo(2, "l").currentline end
+assert(where() == 74, [[Functions that call others keep their stack level.]])
+
+
+local function sq (x) return x * x end
+calls = 0
+debug.sethook(count, "c")
+local q = sq(3)
+debug.sethook()
+assert(q == 9 and calls == 1, [[Functions that may raise errors are not inlined.]])
+
+local src = "local function bad (a)\n  return a + 1\nend\nlocal r = bad(nil)\nreturn r"
+local ok, msg = pcall(load(src, "=bad"))
+assert(not ok and msg:find("^bad:2:") and msg:find("local 'a'"),
+       [[Errors in called local functions report their own lines and names.]])
+ok, msg = xpcall(load(src, "=bad"), debug.traceback)
+assert(not ok and msg:find("in local 'bad'"),
+       [[Errors in called local functions keep their frames.]])
@@ -0,0 +1,50 @@
+local s, f = 0, 0.0
+for i = 1, 1000 do
+    if i % 3 == 0 then s = s + i else s = s - 1 end
+    f = f / 2 + 1.5
+end
+assert(s == 166833 - 667 and f == 3.0, [[Hot loops give the same results in native code.]])
+
+
+local m = math.maxinteger
+for i = 1, 100 do m = m + 1 - 1 end
+assert(m + 1 == math.mininteger, [[Native integer arithmetic wraps around.]])
+
+
+local count = 0
+debug.sethook(function () count = count + 1 end, "", 100)
+local n = 0
+for i = 1, 100000 do n = n + 1 end
+debug.sethook()
+assert(n == 100000 and count >= 900, [[Hooks run inside hot loops.]])
+
+
+local keys = setmetatable({}, {__index = function (_, k)
+    return coroutine.yield(k)
+end})
+local co = coroutine.wrap(function ()
+    local sum = 0
+    for i = 1, 200 do sum = sum + keys[i] end
+    return sum
+end)
+local r = co()
+while r <= 200 do r = co(r) end
+assert(r == 20100, [[Hot loops can yield inside metamethods.]])
+
+
+local function fail (t)
+    local x = 0
+    for i = 1, 1000 do x = x + t[i] end
+    return x
+end
+local ok, msg = pcall(fail, setmetatable({}, {__index = function (_, i)
+    return i < 500 and i or nil
+end}))
+assert(not ok and msg:find(":37:"), [[Errors in native code keep their lines.]])
+
+
+local function deep (n) if n == 0 then return 0 end return 1 + deep(n - 1) end
+local grow = setmetatable({}, {__index = function (_, i) return deep(100) + i end})
+local total = 0
+for i = 1, 300 do total = total + grow[i] end
+assert(total == 30000 + 45150, [[Native code survives stack reallocation.]])
@@ -0,0 +1,26 @@
+local function chunk ()
+    local function add (a, b) return a + b end
+    local function mk (x) return function () return x end end
+    return add, mk
+end
+local image = string.dump(chunk)
+
+
+local add, mk = load(image, "lazy", "bl")()
+assert(add(1, 2) == 3 and mk(4)() == 4,
+       [[Lazily loaded binary chunks run like eager ones.]])
+
+
+local lazy = load(image, "lazy", "bl")
+assert(string.dump(lazy) == image,
+       [[Lazily loaded functions dump back to the same chunk.]])
+
+
+local stripped = load(string.dump(lazy, true), "lazy", "b")
+add, mk = stripped()
+assert(add(5, 6) == 11 and mk(7)() == 7,
+       [[Lazily loaded functions can be dumped stripped.]])
+
+
+assert(not pcall(load(image:sub(1, -10), "lazy", "bl") or error),
+       [[Truncated chunks still fail to load.]])
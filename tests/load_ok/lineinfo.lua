@@ -0,0 +1,37 @@
+local src, expected, line = {}, {}, 1
+local function add (code, gap)
+    for i = 1, gap or 0 do src[#src + 1] = ""; line = line + 1 end
+    src[#src + 1] = code
+    line = line + 1
+end
+add("local r = {}")
+for i = 1, 150 do
+    add("r[#r + 1] = debug.getinfo(1, 'l').currentline")
+    expected[#expected + 1] = line - 1
+end
+for _, gap in ipairs{200, 1, 127, 128, 1000} do
+    add("r[#r + 1] = debug.getinfo(1, 'l').currentline", gap)
+    expected[#expected + 1] = line - 1
+end
+add("if ... then local x = nil + 1 end", 300)
+local errline = line - 1
+add("return r")
+src = table.concat(src, "\n")
+
+
+local function check (f, what)
+    local r = f()
+    assert(#r == #expected, what)
+    for i = 1, #r do assert(r[i] == expected[i], what) end
+    local ok, msg = pcall(f, true)
+    assert(not ok and msg:find("^lineinfo:" .. errline .. ":"), what)
+    local active = debug.getinfo(f, "L").activelines
+    for i = 1, #expected do assert(active[expected[i]], what) end
+end
+
+local f = assert(load(src, "=lineinfo"))
+check(f, [[Long functions with large line gaps report their lines.]])
+check(load(string.dump(f), "=lineinfo", "b"),
+      [[Line information survives a dump and load.]])
+assert(#load(string.dump(f, true), "=lineinfo", "b")() == #expected,
+       [[Functions without line information still run.]])
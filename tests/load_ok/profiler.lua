@@ -0,0 +1,27 @@
+assert(profiler.stop() == "", [[Stopping a profiler that is not running gives no samples.]])
+
+
+local function busy ()
+    local t, s = os.clock(), 0
+    while os.clock() - t < 0.2 do
+        for i = 1, 1000 do s = s + i % 7 end
+    end
+    return s
+end
+
+profiler.start(1)
+assert(not pcall(profiler.start), [[Only one profiler runs at a time.]])
+busy()
+local out = profiler.stop()
+
+local total, found = 0, false
+for stack, count in out:gmatch("([^\n]*) (%d+)\n") do
+    total = total + tonumber(count)
+    found = found or stack:find("busy (", 1, true) ~= nil
+end
+assert(total > 0 and found, [[The profiler counts folded stacks of the running functions.]])
+assert(not out:find(";;", 1, true), [[Stack frames are separated by single semicolons.]])
+
+
+local co = coroutine.wrap(function () profiler.start(1); busy(); return profiler.stop() end)
+assert(co():find("busy (", 1, true), [[The profiler samples running coroutines.]])
@@ -0,0 +1,44 @@
+local function add (a, b) return a + b end
+local function mul (a, b) return a * b end
+
+
+local image = string.dump(add)
+for _ = 1, 3 do assert(add(1, 2) == 3) end
+assert(math.type(add(1.5, 2)) == "float" and add(1.5, 2) == 3.5,
+       [[Quickened integer arithmetic handles floats.]])
+for _ = 1, 3 do assert(add(0.5, 0.25) == 0.75) end
+assert(math.type(add(1, 2)) == "integer",
+       [[Quickened float arithmetic handles integers.]])
+assert(add("10", 1) == 11, [[Quickened arithmetic handles strings.]])
+
+
+local mt = {__add = function () return "tm" end}
+assert(add(setmetatable({}, mt), 1) == "tm",
+       [[Quickened arithmetic calls metamethods.]])
+
+
+assert(string.dump(add) == image, [[Dumps do not include quickened code.]])
+
+
+for i = 1, 20 do
+    local a, b = i % 2 == 0 and i or i + 0.5, i % 3 == 0 and 2 or 2.0
+    assert(mul(a, b) == a * 2 and math.type(mul(a, b)) == math.type(a * b),
+           [[Unstable operand types keep arithmetic correct.]])
+end
+
+
+assert(add(math.maxinteger, 1) == math.mininteger,
+       [[Quickened integer arithmetic wraps around.]])
+
+
+local names = {}
+local obj = setmetatable({}, {__add = function (a, b)
+    coroutine.yield()
+    names[#names + 1] = debug.getinfo(1, "n").name
+    return 42
+end})
+local co = coroutine.wrap(function () return add(obj, 1) end)
+co()  -- yields inside '__add'
+for i = 1, 10 do add(i, 2) end  -- quickens the instruction again
+assert(co() == 42 and names[1] == "__add",
+       [[Metamethods can yield in instructions quickened meanwhile.]])
@@ -0,0 +1,55 @@
+macro swap (a, b)
+    return string.format([[local tmp = %s; %s = %s; %s = tmp]], a, a, b, b)
+end
+local code = "local x, y = 1, 2\n" .. string.rep("swap(x, y)\n", 301) ..
+             "return x, y"
+local x, y = assert(load(code))()
+assert(x == 2 and y == 1, [[Shadowed locals give their registers back.]])
+
+
+local fs = {}
+local v = 1
+fs[1] = function () return v end
+local v = v + 1
+fs[2] = function () return v end
+local v, w = v + 1, v
+assert(fs[1]() == 1 and fs[2]() == 2 and v == 3 and w == 2,
+       [[Closures keep the values of shadowed locals.]])
+
+
+local a, b = 1, 2
+local b, a = a, b
+assert(a == 2 and b == 1, [[Shadowed locals can be redeclared in any order.]])
+
+
+local function locals ()
+    local n, names = 1, {}
+    while true do
+        local name, value = debug.getlocal(2, n)
+        if not name then return names end
+        names[name] = value
+        n = n + 1
+    end
+end
+do
+    local t = 1
+    local t = t + 1
+    local u = 3
+    local t = t + u
+    local l = locals()
+    assert(l.t == 5 and l.u == 3, [[Debug information sees live locals.]])
+end
+
+
+assert(not load("do local x = 1; goto l; local x = 2; ::l:: print(x) end"),
+       [[Shadowing locals do not let gotos jump into their scope.]])
+
+do
+    local n = 0
+    local x = 1
+    ::top::
+    local x = x + 1
+    n = n + 1
+    if n < 5 then goto top end
+    assert(x == 2, [[Locals shadowed after a label keep their values.]])
+end
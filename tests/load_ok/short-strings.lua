@@ -0,0 +1,25 @@
+-- Strings of every length compare and index tables by their contents,
+-- whichever of them the build keeps as short (internalized) strings.
+
+local t = {}
+for n = 1, 300 do
+    t[string.rep("k", n)] = n
+end
+
+for n = 1, 300 do
+    local built = table.concat({string.rep("k", n - 1), "k"})
+    assert(built == string.rep("k", n) and t[built] == n,
+           [[Strings built in different ways are equal and find the same keys.]])
+end
+
+
+local long = "config.section_12.subsection.field_name_number_1234_xxxxxxxxxx"
+local parts = {"config", "section_12", "subsection", "field_name_number_1234_xxxxxxxxxx"}
+local cfg = {[long] = true}
+assert(cfg[table.concat(parts, ".")] and rawequal(table.concat(parts, "."), long),
+       [[Long identifiers built at run time match constants.]])
+
+
+local s = string.rep("a", 254)
+assert(s .. "b" ~= s .. "c" and #(s .. "b") == 255 and (s .. "b"):sub(-1) == "b",
+       [[Strings around the largest short length keep their contents.]])
@@ -0,0 +1,67 @@
+local s = ""
+for i = 1, 2000 do s = s .. i .. "," end
+local parts = {}
+for i = 1, 2000 do parts[i] = i .. "," end
+assert(s == table.concat(parts), [[Repeated appends build the whole string.]])
+
+
+local base = ("a"):rep(1000)
+local x = base .. "x"
+local y = base .. "y"
+assert(#x == 1001 and #y == 1001 and x:sub(-1) == "x" and y:sub(-1) == "y",
+       [[Appending to the same prefix twice gives independent strings.]])
+
+local x2 = x .. "1"
+local x3 = x .. "2"
+assert(x2 ~= x3 and x2:sub(1, 1001) == x and x3:sub(1, 1001) == x,
+       [[Older strings keep their contents after later appends.]])
+
+
+local big = ("0123456789"):rep(200)
+local sub = big:sub(11, 1990)
+assert(#sub == 1980 and sub == ("0123456789"):rep(198),
+       [[Large substrings have the right contents.]])
+assert(big:sub(1) == big and big:sub(1, -1) == big, [[Whole substrings are equal.]])
+
+local t = {}
+t[sub] = true
+assert(t[("0123456789"):rep(198)], [[Substrings work as table keys.]])
+
+local tail = big
+for i = 1, 100 do tail = tail:sub(2) end
+assert(tail == big:sub(101) and #tail == 1900, [[Substrings of substrings work.]])
+
+local grown = sub .. "!"
+assert(grown:sub(-2) == "9!" and sub:sub(-1) == "9",
+       [[Appending to a substring does not change its original.]])
+
+
+local n = ("1"):rep(600)
+assert(tonumber(n:sub(1, 3)) == 111, [[Short substrings convert to numbers.]])
+local padded = (" "):rep(600) .. "42"
+local num = padded .. ""
+assert(tonumber(num) == 42 and num + 0 == 42, [[Large strings convert to numbers.]])
+assert(tonumber((" "):rep(600) .. "42" .. ("0"):rep(1), 10) == 420,
+       [[Large strings convert to numbers in other bases.]])
+
+
+local a = ("b"):rep(700) .. "a"
+local b = ("b"):rep(700) .. "b"
+assert(a < b and b > a and a <= a .. "", [[Large strings compare by contents.]])
+local shared = big:sub(1, 1000)
+assert(shared < big and not (big < shared), [[Shared substrings compare by contents.]])
+
+
+assert(("%s"):format(sub):sub(1, 10) == "0123456789" and
+       string.format("%q", sub):sub(2, 11) == "0123456789",
+       [[C functions see terminated large strings.]])
+assert(string.find(big, "90123", 1000, true) == 1000 and
+       select(2, string.gsub(sub, "0", "")) == 198,
+       [[Library functions read shared substrings.]])
+
+
+local mode = ("k" .. (" "):rep(700) .. "v"):sub(1, 600)
+local weak = setmetatable({}, {__mode = mode})
+weak[{}] = 1
+collectgarbage()
+assert(next(weak) == nil, [[Substrings work as weak modes.]])
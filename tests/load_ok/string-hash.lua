@@ -0,0 +1,29 @@
+-- strings of all lengths around word boundaries, as short and long strings
+local t = {}
+local n = 0
+for len = 0, 70 do
+    for c = 0, 3 do
+        local s = string.rep("a", len) .. string.char(65 + c)
+        t[s] = len * 4 + c
+        n = n + 1
+    end
+end
+for len = 0, 70 do
+    for c = 0, 3 do
+        local s = string.rep("a", len) .. string.char(65 + c)
+        assert(t[s] == len * 4 + c, [[Strings of any length work as keys.]])
+    end
+end
+
+
+-- long keys differing only in a few bytes
+local pad = string.rep("x", 63)
+local keys = {}
+for i = 1, 1000 do
+    keys[i] = (string.format("%04d", i):gsub(".", function (d) return pad .. d end))
+    t[keys[i]] = i
+end
+for i = 1, 1000 do
+    assert(t[keys[i]] == i and t[keys[i] .. ""] == i,
+           [[Long keys with equal contents find the same entry.]])
+end
@@ -0,0 +1,58 @@
+local st = collectgarbage("strstats")
+assert(math.type(st.size) == "integer" and st.size >= 128 and
+       st.nuse > 0 and st.nuse <= st.size and st.maxchain >= 1,
+       [[String table statistics report its size, strings and longest chain.]])
+
+
+local prefix = "\1"  -- (strings short enough in any build)
+local before = collectgarbage("strstats")
+local keep = {}
+for i = 1, 100 do keep[i] = prefix .. i end
+local after = collectgarbage("strstats")
+assert(after.misses - before.misses >= 100,
+       [[New short strings count as misses.]])
+
+before = collectgarbage("strstats")
+for i = 1, 100 do assert(prefix .. i == keep[i]) end
+after = collectgarbage("strstats")
+assert(after.hits - before.hits >= 100,
+       [[Existing short strings count as hits.]])
+
+
+assert(collectgarbage("setstrgrow", 400) == 100 and
+       collectgarbage("setstrshrink", 10) == 25,
+       [[The grow and shrink loads start at their defaults.]])
+local size = collectgarbage("strstats").size
+for i = 101, 2 * size do keep[i] = prefix .. i end
+st = collectgarbage("strstats")
+assert(st.size == size and st.nuse > st.size,
+       [[A higher grow load lets the string table hold more strings than slots.]])
+
+assert(collectgarbage("setstrgrow", 100) == 400,
+       [[Setting a load returns the previous one.]])
+for i = 2 * size + 1, 4 * size do keep[i] = prefix .. i end
+st = collectgarbage("strstats")
+assert(st.size > size and st.nuse <= st.size,
+       [[The string table grows at the default load.]])
+
+keep = nil
+collectgarbage("setstrshrink", 0)
+collectgarbage()
+assert(collectgarbage("strstats").size == st.size,
+       [[A zero shrink load keeps the string table from shrinking.]])
+
+collectgarbage("setstrshrink", 25)
+for i = 1, 10 do collectgarbage() end
+assert(collectgarbage("strstats").size < st.size,
+       [[The string table shrinks when it gets empty.]])
+
+assert(collectgarbage("setstrgrow", 1) == 100 and
+       collectgarbage("setstrgrow", 100) == 10,
+       [[Grow loads are at least 10.]])
+
+
+collectgarbage("setstrshrink", 1000000000)
+for i = 1, 10 do collectgarbage() end
+assert(collectgarbage("strstats").size >= 128,
+       [[Huge shrink loads do not empty the string table.]])
+collectgarbage("setstrshrink", 25)
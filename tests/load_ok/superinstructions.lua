@@ -0,0 +1,44 @@
+local t = {a = {b = {c = 42}}}
+assert(t.a.b.c == 42, [[Chains of table reads are executed as superinstructions.]])
+
+
+superglobal = {field = {value = 7}}
+assert(superglobal.field.value == 7,
+       [[Global tables and their fields are read by superinstructions.]])
+
+
+function supercall () return "called" end
+assert(supercall() == "called", [[Calls to globals are executed as superinstructions.]])
+
+
+local ok, msg = pcall(function () undefinedsuper() end)
+assert(not ok and msg:find("global 'undefinedsuper'"),
+       [[Errors in superinstructions keep variable names.]])
+
+
+ok, msg = pcall(function () local u = {} return u.x.y end)
+assert(not ok and msg:find("field 'x'"),
+       [[Errors in fused table reads keep field names.]])
+
+
+local lines = {}
+debug.sethook(function (_, l) lines[#lines + 1] = l end, "l")
+local v = t.a
+.b
+debug.sethook()
+assert(v.c == 42 and lines[1] == 26 and lines[2] == 27,
+       [[Hooks see both instructions of a superinstruction.]])
+
+
+local g = load(string.dump(function (x) return x.a.b.c end))
+assert(g(t) == 42, [[Dumped superinstructions are written as plain opcodes.]])
+
+
+local co = coroutine.wrap(function ()
+    local p = setmetatable({}, {__index = function (_, k)
+        return coroutine.yield(k)
+    end})
+    return p.key.len
+end)
+assert(co() == "key" and co({len = 3}) == 3,
+       [[Superinstructions can yield inside metamethods.]])
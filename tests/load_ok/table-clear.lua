@@ -0,0 +1,36 @@
+local t = {1, 2, 3, x = 1, y = 2}
+table.clear(t)
+assert(next(t) == nil and #t == 0, [[table.clear removes all fields.]])
+
+for i = 1, 3 do t[i] = i * 10 end
+t.z = true
+assert(#t == 3 and t[2] == 20 and t.z and t.x == nil,
+       [[Cleared tables can be filled again.]])
+
+
+local mt = {__index = function () return "mt" end}
+local o = setmetatable({}, mt)
+assert(o.any == "mt", [[Metatable works before clearing.]])
+table.clear(mt)
+assert(o.any == nil and getmetatable(o) == mt,
+       [[Clearing a metatable removes its metamethods but not the metatable.]])
+
+
+local logged = setmetatable({}, {__newindex = error})
+rawset(logged, "a", 1)
+table.clear(logged)
+assert(rawget(logged, "a") == nil, [[table.clear ignores metamethods.]])
+
+
+local w = setmetatable({}, {__mode = "k"})
+w[{}] = 1
+table.clear(w)
+collectgarbage()
+assert(next(w) == nil, [[Cleared weak tables stay consistent with the collector.]])
+
+
+local function get (tab) return tab.k end
+local s = {k = 1}
+for i = 1, 3 do assert(get(s) == 1) end
+table.clear(s)
+assert(get(s) == nil, [[Cached table reads see cleared fields.]])
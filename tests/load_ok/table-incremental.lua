@@ -0,0 +1,92 @@
+-- large hash parts (2^16 nodes or more) grow incrementally
+local N = 300000
+local t = {}
+for i = 1, N do
+    t["k" .. i] = i
+    if i % 9973 == 0 then
+        for j = i - 100, i do
+            assert(t["k" .. j] == j, [[Keys stay visible while a table grows.]])
+        end
+    end
+end
+
+local n, sum = 0, 0
+for k, v in pairs(t) do
+    n = n + 1
+    sum = sum + v
+end
+assert(n == N and sum == N * (N + 1) // 2,
+       [[Traversals see each key once while a table grows.]])
+
+
+for i = 1, N, 2 do t["k" .. i] = nil end
+for i = N + 1, N + 1000 do t["k" .. i] = i end
+n = 0
+for k, v in pairs(t) do
+    assert(t[k] == v and v % 2 == 0 or v > N, [[Removed keys are not traversed.]])
+    t[k] = nil  -- clearing fields is allowed during traversal
+    n = n + 1
+end
+assert(n == N // 2 + 1000 and next(t) == nil,
+       [[Fields can be removed during a traversal of a growing table.]])
+
+
+local f = {}
+for i = 1, N do f[-i] = i; f[i + 0.5] = i end
+for i = 1, N, 997 do
+    assert(f[-i] == i and f[i + 0.5] == i, [[Number keys survive a resize.]])
+end
+
+
+local w = setmetatable({}, {__mode = "k"})
+local keep = {}
+for i = 1, 100000 do
+    local k = {}
+    if i % 10 == 0 then keep[#keep + 1] = k end
+    w[k] = i
+end
+collectgarbage()
+n = 0
+for k, v in pairs(w) do
+    assert(v % 10 == 0, [[Weak tables keep only live keys while growing.]])
+    n = n + 1
+end
+assert(n == #keep, [[Weak tables keep all live keys while growing.]])
+for i = 1, 1000 do w[{}] = i end
+table.clear(w)
+assert(next(w) == nil, [[A growing table can be cleared.]])
+
+
+collectgarbage()
+local base = collectgarbage("count")
+local W = 40000
+local c = {}
+for i = 1, W do c[i .. "c"] = i end
+local function churn (from, to)
+    for i = from, to do c[i .. "c"] = i; c[(i - W) .. "c"] = nil end
+end
+churn(W + 1, 200000)
+collectgarbage()
+local used = collectgarbage("count") - base
+for i = 300000, 800000, 100000 do
+    churn(i - 99999, i)
+    collectgarbage()
+    assert(collectgarbage("count") - base < used * 2.5,
+           [[Tables with churn drop the nodes of removed keys.]])
+end
+for i = 800001 - W, 800000, 1009 do
+    assert(c[i .. "c"] == i and c[(i - W) .. "c"] == nil,
+           [[Tables with churn keep their live keys.]])
+end
+
+
+local s = {}
+for i = 1, 200000 do s[i .. "s"] = i end
+for i = 1, 160000 do s[i .. "s"] = nil end
+for i = 200001, 260000 do s[i .. "s"] = i end
+n = 0
+for k, v in pairs(s) do
+    assert(s[k] == v and v > 160000, [[Shrinking tables keep their live keys.]])
+    n = n + 1
+end
+assert(n == 100000, [[Shrinking tables keep all their live keys.]])
@@ -0,0 +1,42 @@
+local t = {}
+for i = 1, 1000 do
+    t[#t + 1] = i
+    assert(#t == i, [[Length follows appends.]])
+end
+for i = 1000, 1, -1 do
+    assert(#t == i, [[Length follows removals from the end.]])
+    t[#t] = nil
+end
+assert(#t == 0, [[Emptied tables have length zero.]])
+
+
+local function isborder (a, n)
+    return (n == 0 or a[n] ~= nil) and a[n + 1] == nil
+end
+
+local a = {1, 2, 3, nil, 5, nil, nil, 8}
+assert(isborder(a, #a), [[Length of a table with holes is a border.]])
+a[9], a[10] = 9, 10
+assert(isborder(a, #a), [[Length is a border after changing the table.]])
+a[#a] = nil
+a[1] = nil
+assert(isborder(a, #a), [[Length is a border after removing elements.]])
+table.clear(a)
+assert(#a == 0, [[Cleared tables have length zero.]])
+
+
+local h = {}
+h[1], h[2], h[3] = 1, 2, 3  -- all in the hash part
+assert(#h == 3, [[Length works for the hash part.]])
+h[4] = 4
+assert(#h == 4, [[Length follows appends to the hash part.]])
+h[3] = nil
+assert(isborder(h, #h), [[Length is a border in the hash part.]])
+
+
+local big = table.new(100)
+for i = 1, 200 do big[#big + 1] = i end
+assert(#big == 200 and big[200] == 200,
+       [[Appends keep working when they grow the array part.]])
+for i = 1, 150 do big[i] = nil end
+assert(isborder(big, #big), [[Length is a border after a rehash.]])
@@ -0,0 +1,13 @@
+local t = table.new(100, 10)
+assert(type(t) == "table" and next(t) == nil and #t == 0,
+       [[table.new creates an empty table.]])
+
+for i = 1, 100 do t[i] = i end
+for i = 1, 10 do t["k" .. i] = i end
+assert(#t == 100 and t.k10 == 10, [[Tables from table.new are filled like any other.]])
+
+t[1000] = true
+assert(t[1000] and #table.new() == 0, [[Tables from table.new grow beyond their sizes.]])
+
+assert(not pcall(table.new, -1) and not pcall(table.new, 0, -1),
+       [[table.new rejects negative sizes.]])
@@ -0,0 +1,136 @@
+local N = 1 << 16
+
+collectgarbage()
+collectgarbage("stop")
+local before = collectgarbage("count")
+local t = {}
+for i = 1, N do t[i] = i end
+local size = (collectgarbage("count") - before) * 1024
+collectgarbage("restart")
+assert(size < 10 * N,
+       [[Sequences of integers take less than a TValue per element.]])
+
+local f = {}
+for i = 1, N do f[i] = i + 0.5 end
+local ok = true
+for i = 1, N do ok = ok and t[i] == i and math.type(t[i]) == "integer" end
+for i = 1, N do ok = ok and f[i] == i + 0.5 end
+assert(ok and #t == N and #f == N and rawlen(t) == N,
+       [[Packed sequences keep their values and lengths.]])
+
+local g = {}
+for i = 1, 100 do g[i] = i + 0.0 end
+assert(math.type(g[50]) == "float" and math.type(rawget(g, 50)) == "float",
+       [[Floats with integral values stay floats.]])
+
+
+local s = 0
+for i = 1, N do t[i] = t[i] * 2; s = s + t[i] end
+t[N + 1] = 0
+t[N + 1] = nil
+assert(s == N * (N + 1) and #t == N and t[N] == 2 * N,
+       [[Elements of packed sequences can be replaced.]])
+
+t[N] = nil
+t[N - 1] = nil
+assert(#t == N - 2 and t[N - 1] == nil and t[N - 2] == 2 * (N - 2),
+       [[Removing the last elements shortens packed sequences.]])
+
+
+local h = {}
+for i = 1, 50 do h[i] = i end
+h[10] = "ten"
+h[20] = 20.5
+h[30] = nil
+h.x = true
+ok = h[10] == "ten" and h[20] == 20.5 and h[30] == nil and h.x
+for i = 1, 50 do
+    if i ~= 10 and i ~= 20 and i ~= 30 then ok = ok and h[i] == i end
+end
+assert(ok, [[Stores of other types or of holes keep all other elements.]])
+
+local n = 0
+for k, v in pairs(h) do
+    n = n + 1
+    assert(rawget(h, k) == v)
+end
+assert(n == 50, [[Traversals see all elements after a sequence is unpacked.]])
+
+
+local p = {}
+for i = 1, 40 do p[i] = i end
+p[60] = 60
+p.name = "p"
+n = 0
+local sum = 0
+for k, v in pairs(p) do
+    n = n + 1
+    if math.type(k) == "integer" then sum = sum + v end
+end
+assert(n == 42 and sum == 40 * 41 / 2 + 60,
+       [[Traversals of packed sequences see the other keys.]])
+
+for k in pairs(p) do
+    if k == 40 then p[40] = nil; p[3] = nil end
+end
+assert(p[40] == nil and p[3] == nil and p[39] == 39,
+       [[Elements of packed sequences can be removed while traversing them.]])
+
+for k in pairs(p) do p[k] = nil end
+assert(next(p) == nil,
+       [[Packed sequences can be cleared while traversing them.]])
+
+
+local m = {}
+for i = 1, 20 do m[i] = i end
+for i = 22, 30 do m[i] = i end
+m[21] = 21
+assert(#m == 30 and m[25] == 25 and m[21] == 21,
+       [[Keys after a packed sequence are found.]])
+m[2.0] = 200
+assert(m[2] == 200 and rawget(m, 2.0) == 200,
+       [[Float keys with integral values index packed sequences.]])
+
+
+local calls = 0
+local mt = {
+    __newindex = function (t, k, v) calls = calls + 1; rawset(t, k, v) end,
+    __index = function () calls = calls + 1 end
+}
+local w = setmetatable({}, mt)
+for i = 1, 20 do w[i] = i end
+calls = 0
+for i = 1, 20 do w[i] = w[i] + 1 end
+assert(calls == 0, [[Existing elements do not call metamethods.]])
+w[21] = 22
+local _ = w[22]
+assert(calls == 2 and w[21] == 22, [[New keys call metamethods.]])
+
+
+local q = {}
+for i = 1, 100 do q[i] = 101 - i end
+table.sort(q)
+table.insert(q, 1, 0)
+table.insert(q, 101)
+assert(q[1] == 0 and q[2] == 1 and q[101] == 100 and q[102] == 101 and
+       #q == 102,
+       [[Library functions work with packed sequences.]])
+assert(table.remove(q, 1) == 0 and table.remove(q) == 101 and #q == 100 and
+       table.concat(q, ",", 1, 3) == "1,2,3" and
+       select("#", table.unpack(q)) == 100,
+       [[Library functions remove from packed sequences.]])
+table.move(q, 1, 100, 51)
+assert(#q == 150 and q[51] == 1 and q[150] == 100,
+       [[Packed sequences can be moved.]])
+table.clear(q)
+assert(next(q) == nil and #q == 0, [[Packed sequences can be cleared.]])
+for i = 1, 10 do q[i] = i * 2 end
+assert(#q == 10 and q[10] == 20, [[Cleared sequences can grow again.]])
+
+
+local mixed = {}
+for i = 1, 30 do mixed[i] = i end
+mixed[31] = 31.5
+mixed[32] = 32
+assert(#mixed == 32 and mixed[31] == 31.5 and mixed[32] == 32,
+       [[Appending a value of another type keeps the sequence.]])
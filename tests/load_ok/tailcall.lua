@@ -0,0 +1,55 @@
+local function loop (n, acc)
+    if n == 0 then return acc end
+    return loop(n - 1, acc + n)
+end
+assert(loop(1000000, 0) == 500000500000, [[Tail calls run in constant stack space.]])
+
+
+local function count (n, ...)
+    if n == 0 then return select("#", ...), ... end
+    return count(n - 1, n, ...)
+end
+local c, a, b = count(10)
+assert(c == 10 and a == 1 and b == 2, [[Tail calls pass variable arguments.]])
+
+
+local function fixed (a, b, c) return a, b, c end
+local function call1 (...) return fixed(...) end
+local x, y, z = call1(1)
+assert(x == 1 and y == nil and z == nil, [[Tail calls complete missing arguments.]])
+x, y, z = call1(1, 2, 3, 4)
+assert(x == 1 and y == 2 and z == 3, [[Tail calls drop extra arguments.]])
+
+
+local function vfixed (a, ...) return a, select("#", ...), ... end
+local function call2 (f, ...) return f(...) end
+local n, m, v = call2(vfixed, "a", "b")
+assert(n == "a" and m == 1 and v == "b",
+       [[Tail calls to vararg functions split fixed and variable arguments.]])
+
+
+local fs = {}
+local function mk (i) return function () return i end end
+local function tailmk (i) local j = i * 2; fs[i] = function () return j end; return mk(j) end
+assert(tailmk(3)() == 6 and fs[3]() == 6, [[Tail calls close upvalues of the caller.]])
+
+
+local callable = setmetatable({}, {__call = function (self, v) return v end})
+local function tocall (v) return callable(v) end
+local function toc (s) return string.upper(s) end
+assert(tocall(7) == 7 and toc("x") == "X",
+       [[Tail calls work with C functions and __call.]])
+
+
+local function level () return debug.getinfo(1, "t").istailcall end
+local function tail () return level() end
+assert(tail() == true, [[Tail-called functions are marked as such.]])
+
+
+local events = {}
+debug.sethook(function (e) events[#events + 1] = e end, "c")
+tail()
+debug.sethook()
+local found = false
+for _, e in ipairs(events) do found = found or e == "tail call" end
+assert(found, [[Call hooks see tail calls.]])